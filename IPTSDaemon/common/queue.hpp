@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_COMMON_QUEUE_HPP
+#define IPTSD_COMMON_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+
+namespace iptsd::common {
+
+/*
+ * A lock-free queue between exactly one producer and one consumer thread.
+ *
+ * The slots are allocated once and reused, elements are filled in place:
+ * The producer writes into back() and publishes it with push(), the consumer
+ * reads front() and gives the slot back with pop().
+ */
+template <class T, std::size_t N> class SpscQueue {
+	static_assert(std::has_single_bit(N), "The size of the queue must be a power of two");
+
+private:
+	std::array<T, N> m_slots {};
+
+	// Only written by the producer and the consumer respectively.
+	alignas(64) std::atomic<std::size_t> m_head = 0;
+	alignas(64) std::atomic<std::size_t> m_tail = 0;
+
+public:
+	// The slot that is filled next, or nullptr if the queue is full.
+	T *back();
+	void push();
+
+	// The oldest element, or nullptr if the queue is empty.
+	T *front();
+	void pop();
+
+	[[nodiscard]] bool empty() const;
+};
+
+template <class T, std::size_t N> inline T *SpscQueue<T, N>::back()
+{
+	const std::size_t head = m_head.load(std::memory_order_relaxed);
+	const std::size_t tail = m_tail.load(std::memory_order_acquire);
+
+	if (head - tail == N)
+		return nullptr;
+
+	return &m_slots[head & (N - 1)];
+}
+
+template <class T, std::size_t N> inline void SpscQueue<T, N>::push()
+{
+	m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template <class T, std::size_t N> inline T *SpscQueue<T, N>::front()
+{
+	const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+	const std::size_t head = m_head.load(std::memory_order_acquire);
+
+	if (head == tail)
+		return nullptr;
+
+	return &m_slots[tail & (N - 1)];
+}
+
+template <class T, std::size_t N> inline void SpscQueue<T, N>::pop()
+{
+	m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template <class T, std::size_t N> inline bool SpscQueue<T, N>::empty() const
+{
+	return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+}
+
+} /* namespace iptsd::common */
+
+#endif /* IPTSD_COMMON_QUEUE_HPP */
@@ -10,7 +10,10 @@
 #include <cctype>
 #include <cmath>
 #include <filesystem>
+#include <cstdint>
+#include <gsl/gsl>
 #include <ini.h>
+#include <stdexcept>
 #include <string>
 
 namespace filesystem = std::filesystem;
@@ -85,6 +88,9 @@ static int parse_conf(void *user, const char *c_section, const char *c_name, con
 	if (section == "Touch" && name == "DisableOnStylus")
 		config->touch_disable_on_stylus = to_bool(value);
 
+	if (section == "Touch" && name == "Coalesce")
+		config->touch_coalesce = to_bool(value);
+
 	if (section == "Contacts" && name == "Detection") {
 		std::transform(value.begin(), value.end(), value.begin(), ::tolower);
 		config->contacts_detection = value;
@@ -131,6 +137,15 @@ static int parse_conf(void *user, const char *c_section, const char *c_name, con
 	if (section == "Contacts" && name == "DistanceThreshold")
 		config->contacts_distance_thresh = std::stof(value);
 
+	if (section == "Contacts" && name == "PredictionLatency")
+		config->contacts_prediction_latency = std::stof(value);
+
+	if (section == "Contacts" && name == "PredictionAlpha")
+		config->contacts_prediction_alpha = std::stof(value);
+
+	if (section == "Contacts" && name == "PredictionBeta")
+		config->contacts_prediction_beta = std::stof(value);
+
 	if (section == "Stylus" && name == "Disable")
 		config->stylus_disable = to_bool(value);
 
@@ -164,6 +179,16 @@ static int parse_conf(void *user, const char *c_section, const char *c_name, con
 	if (section == "DFT" && name == "TipDistance")
 		config->dft_tip_distance = std::stof(value);
 
+	if (section == "Debug" && name == "Telemetry") {
+		const unsigned long interval = std::stoul(value);
+
+		// std::stoul accepts negative numbers and wraps them around
+		if (value.find('-') != std::string::npos || interval > UINT32_MAX)
+			throw std::runtime_error("Invalid telemetry interval!");
+
+		config->debug_telemetry = gsl::narrow_cast<u32>(interval);
+	}
+
 	return 1;
 }
 
@@ -220,6 +245,8 @@ contacts::Config Config::contacts() const
 		config.detection_mode = contacts::BlobDetection::BASIC;
 	else if (this->contacts_detection == "advanced")
 		config.detection_mode = contacts::BlobDetection::ADVANCED;
+	else if (this->contacts_detection == "label")
+		config.detection_mode = contacts::BlobDetection::LABEL;
 
 	if (this->contacts_neutral == "mode")
 		config.neutral_mode = contacts::NeutralMode::MODE;
@@ -241,6 +268,9 @@ contacts::Config Config::contacts() const
 	config.position_thresh_min = this->contacts_position_thresh_min;
 	config.position_thresh_max = this->contacts_position_thresh_max;
 	config.dist_thresh = this->contacts_distance_thresh;
+	config.prediction_latency = this->contacts_prediction_latency;
+	config.prediction_alpha = this->contacts_prediction_alpha;
+	config.prediction_beta = this->contacts_prediction_beta;
     
     config.instability_tolerance = this->touch_instability_tolerance;
 
@@ -31,6 +31,7 @@ public:
 	u8   touch_instability_tolerance = 3;
 	bool touch_disable_on_palm = false;
 	bool touch_disable_on_stylus = false;
+	bool touch_coalesce = false;
 
 	// [Contacts]
 	std::string contacts_detection = "basic";
@@ -47,6 +48,9 @@ public:
 	f32 contacts_position_thresh_min = 0.2;
 	f32 contacts_position_thresh_max = 2;
 	f32 contacts_distance_thresh = 1;
+	f32 contacts_prediction_latency = 0;
+	f32 contacts_prediction_alpha = 0.8;
+	f32 contacts_prediction_beta = 0.3;
 
 	// [Stylus]
 	bool stylus_disable = false;
@@ -65,6 +69,9 @@ public:
 	f32 dft_tilt_distance = 0.6;
 	f32 dft_tip_distance = 0;
 
+	// [Debug]
+	u32 debug_telemetry = 0;
+
 public:
 	Config(i16 vendor, i16 product,
 	       std::optional<const IPTSDeviceMetaData> metadata = std::nullopt);
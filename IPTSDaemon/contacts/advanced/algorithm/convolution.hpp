@@ -13,6 +13,7 @@
 
 #include "opt/convolution.3x3-extend.hpp"
 #include "opt/convolution.5x5-extend.hpp"
+#include "opt/convolution.separable-extend.hpp"
 
 using namespace iptsd::container;
 using namespace iptsd::math;
@@ -113,6 +114,27 @@ void conv_generic(Image<T>& out, Image<T> const& in, Kernel<S, Nx, Ny> const& k)
     }
 }
 
+template<typename B, typename T, typename U, typename S, index_t Nx, index_t Ny, typename F>
+void conv_generic(Image<U>& out, Image<T> const& in, Kernel<S, Nx, Ny> const& k, F const& f)
+{
+    index_t const dx = (Nx - 1) / 2;
+    index_t const dy = (Ny - 1) / 2;
+
+    for (index_t cy = 0; cy < in.size().y; ++cy) {
+        for (index_t cx = 0; cx < in.size().x; ++cx) {
+            T v = math::num<T>::zero;
+
+            for (index_t iy = 0; iy < Ny; ++iy) {
+                for (index_t ix = 0; ix < Nx; ++ix) {
+                    v += B::value(in, {cx - dx + ix, cy - dy + iy}) * k[{ix, iy}];
+                }
+            }
+
+            out[{cx, cy}] = f(v);
+        }
+    }
+}
+
 } /* namespace impl */
 } /* namespace conv */
 
@@ -120,6 +142,17 @@ void conv_generic(Image<T>& out, Image<T> const& in, Kernel<S, Nx, Ny> const& k)
 template<typename B=border::Extend, typename T, typename S, index_t Nx, index_t Ny>
 void convolve(Image<T>& out, Image<T> const& in, Kernel<S, Nx, Ny> const& k)
 {
+    // separable kernels (like gaussians) only need Nx + Ny instead of Nx * Ny operations
+    if constexpr (std::is_same_v<B, border::Extend> && conv::impl::is_flat_v<T, S>) {
+        conv::impl::Kernel1d<S, Nx> kx;
+        conv::impl::Kernel1d<S, Ny> ky;
+
+        if (conv::impl::separate(k, kx, ky)) {
+            conv::impl::conv_separable_extend<T, S, Nx, Ny>(out, in, kx, ky);
+            return;
+        }
+    }
+
     // workaround for partial function template specialization
     if constexpr (Nx == 5 && Ny == 5 && std::is_same_v<B, border::Extend>) {
         conv::impl::conv_5x5_extend<T, S>(out, in, k);
@@ -130,4 +163,25 @@ void convolve(Image<T>& out, Image<T> const& in, Kernel<S, Nx, Ny> const& k)
     }
 }
 
+/*
+ * Convolves in with k and stores f of every result in out, without keeping the convolved
+ * image in memory. This is the same as convolve() followed by container::ops::transform().
+ */
+template<typename B=border::Extend, typename T, typename U, typename S, index_t Nx, index_t Ny,
+         typename F>
+void convolve(Image<U>& out, Image<T> const& in, Kernel<S, Nx, Ny> const& k, F const& f)
+{
+    if constexpr (std::is_same_v<B, border::Extend> && conv::impl::is_flat_v<T, S>) {
+        conv::impl::Kernel1d<S, Nx> kx;
+        conv::impl::Kernel1d<S, Ny> ky;
+
+        if (conv::impl::separate(k, kx, ky)) {
+            conv::impl::conv_separable_extend<T, U, S, Nx, Ny>(out, in, kx, ky, f);
+            return;
+        }
+    }
+
+    conv::impl::conv_generic<B, T, U, S, Nx, Ny>(out, in, k, f);
+}
+
 } /* namespace iptsd::contacts::advanced::alg */
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <common/types.hpp>
+
+#include "tensor.hpp"
+
+#include <container/image.hpp>
+
+#include <math/num.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+using namespace iptsd::container;
+using namespace iptsd::math;
+
+
+namespace iptsd::contacts::advanced::alg {
+
+/*
+ * Computes the structure tensor and the hessian in a single pass over the input. This is the
+ * same as structure_tensor() and hessian() with their default Sobel kernels and zero borders,
+ * but every 3x3 neighbourhood is only read once.
+ *
+ * All five Sobel kernels are built from the same three vertical filters ([1 2 1], [1 0 -1] and
+ * [1 -2 1]), so those are computed once per column and combined horizontally. Rows are processed
+ * in strips, so the vertical results fit into small buffers on the stack.
+ */
+template<typename T>
+void structure_tensor_hessian(TensorImage<T>& st, TensorImage<T>& hs, Image<T> const& in)
+{
+    assert(in.size() == st.size());
+    assert(in.size() == hs.size());
+
+    constexpr index_t strip = 64;
+
+    // vertical filters of the columns x0 - 1 to x1, the borders are zero
+    std::array<T, strip + 2> vs;
+    std::array<T, strip + 2> vd;
+    std::array<T, strip + 2> v2;
+
+    index2_t const size = in.size();
+
+    for (index_t y = 0; y < size.y; ++y) {
+        // rows outside of the image are read from the center row, but weighted with zero
+        T const* top = &in[{0, std::max(y - 1, 0)}];
+        T const* mid = &in[{0, y}];
+        T const* bot = &in[{0, std::min(y + 1, size.y - 1)}];
+
+        T const wt = y > 0 ? math::num<T>::one : math::num<T>::zero;
+        T const wb = y < size.y - 1 ? math::num<T>::one : math::num<T>::zero;
+
+        for (index_t x0 = 0; x0 < size.x; x0 += strip) {
+            index_t const x1 = std::min(x0 + strip, size.x);
+
+            index_t const i0 = std::max(x0 - 1, 0);
+            index_t const i1 = std::min(x1 + 1, size.x);
+
+            vs.front() = vd.front() = v2.front() = math::num<T>::zero;
+            vs[x1 - x0 + 1] = vd[x1 - x0 + 1] = v2[x1 - x0 + 1] = math::num<T>::zero;
+
+            for (index_t x = i0; x < i1; ++x) {
+                T const t = top[x] * wt;
+                T const m = mid[x];
+                T const b = bot[x] * wb;
+
+                vs[x - x0 + 1] = t + 2 * m + b;
+                vd[x - x0 + 1] = t - b;
+                v2[x - x0 + 1] = t - 2 * m + b;
+            }
+
+            index_t const row = y * size.x + x0;
+
+            for (index_t i = 0; i < x1 - x0; ++i) {
+                T const gx = vs[i] - vs[i + 2];
+                T const gy = vd[i] + 2 * vd[i + 1] + vd[i + 2];
+
+                st.xx[row + i] = gx * gx;
+                st.xy[row + i] = gx * gy;
+                st.yy[row + i] = gy * gy;
+
+                hs.xx[row + i] = vs[i] - 2 * vs[i + 1] + vs[i + 2];
+                hs.xy[row + i] = vd[i] - vd[i + 2];
+                hs.yy[row + i] = v2[i] + 2 * v2[i + 1] + v2[i + 2];
+            }
+        }
+    }
+}
+
+} /* namespace iptsd::contacts::advanced::alg */
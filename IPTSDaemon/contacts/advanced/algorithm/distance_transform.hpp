@@ -3,8 +3,14 @@
 #include <common/types.hpp>
 #include <container/image.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <limits>
 #include <queue>
 #include <numeric>
+#include <vector>
 
 using namespace iptsd::container;
 
@@ -55,6 +61,96 @@ auto operator> (struct QItem<T> const& a, struct QItem<T> const& b) noexcept ->
 }
 
 
+/*
+ * A queue item of the transform with two source classes, cls is the class that the cost
+ * belongs to.
+ */
+template<typename T>
+struct ClassItem {
+    index_t idx;
+    T cost;
+    u8 cls;
+};
+
+
+/*
+ * A priority queue for costs between 0 and a limit (Dial's algorithm). Items are sorted into
+ * buckets of a fixed width by their cost, and taken from the lowest non-empty bucket.
+ *
+ * Inside a bucket the order is arbitrary. If the width is at most the smallest cost of a
+ * single step, no item can improve on another one of the same bucket, so the transform
+ * still visits every pixel in the right order. A larger width is not wrong either, but
+ * pixels may be visited more than once.
+ *
+ * The buckets keep their memory, so after the first frames no allocations happen.
+ */
+template<typename I>
+class BucketQueue {
+public:
+    using cost_type = decltype(I::cost);
+
+public:
+    BucketQueue(cost_type limit, cost_type width);
+
+    [[nodiscard]] auto empty() const -> bool;
+
+    void push(I const& item);
+    auto top() -> I const&;
+    void pop();
+
+private:
+    cost_type m_scale;
+    std::vector<std::vector<I>> m_buckets;
+    std::size_t m_current = 0;
+    std::size_t m_count = 0;
+};
+
+template<typename I>
+BucketQueue<I>::BucketQueue(cost_type limit, cost_type width)
+    : m_scale{1 / width}
+    , m_buckets(static_cast<std::size_t>(std::ceil(limit / width)) + 1)
+{}
+
+template<typename I>
+inline auto BucketQueue<I>::empty() const -> bool
+{
+    return m_count == 0;
+}
+
+template<typename I>
+inline void BucketQueue<I>::push(I const& item)
+{
+    if (m_count == 0)
+        m_current = 0;
+
+    auto b = static_cast<std::size_t>(std::max(item.cost * m_scale, cost_type{0}));
+
+    // costs never decrease, except inside of the bucket that is being processed
+    b = std::clamp(b, m_current, m_buckets.size() - 1);
+
+    m_buckets[b].push_back(item);
+    ++m_count;
+}
+
+template<typename I>
+inline auto BucketQueue<I>::top() -> I const&
+{
+    while (m_buckets[m_current].empty())
+        ++m_current;
+
+    return m_buckets[m_current].back();
+}
+
+template<typename I>
+inline void BucketQueue<I>::pop()
+{
+    static_cast<void>(top());
+
+    m_buckets[m_current].pop_back();
+    --m_count;
+}
+
+
 namespace impl {
 
 template<typename T>
@@ -69,6 +165,13 @@ auto is_foreground(T& bin, index_t i) -> bool
     return bin(i);
 }
 
+// A step to a neighbouring pixel, as a type so that the cost can be looked up for it.
+template<index_t DX, index_t DY>
+struct Step {
+    static constexpr index_t dx = DX;
+    static constexpr index_t dy = DY;
+};
+
 template<typename B, typename M>
 auto is_compute(B& bin, M& mask, index_t i) -> bool
 {
@@ -487,4 +590,127 @@ void weighted_distance_transform(Image<T>& out, F& bin, M& mask, C& cost, Q& q,
     }
 }
 
+/*
+ * Computes the weighted distance transform for two kinds of foreground at the same time:
+ * out1 is the distance to the nearest pixel of bin1, out2 to the nearest pixel of bin2.
+ *
+ * This gives the same result as two separate calls, but the image is only scanned once to
+ * find the starting pixels, and both classes are propagated through a single queue. Queue
+ * items carry the class they belong to, and every pixel is visited once per class.
+ */
+template<int N=8, typename T, typename F1, typename F2, typename M, typename C, typename Q>
+void weighted_distance_transform(Image<T>& out1, Image<T>& out2, F1& bin1, F2& bin2, M& mask,
+                                 C& cost, Q& q, T limit=std::numeric_limits<T>::max())
+{
+    static_assert(N == 4 || N == 8);
+
+    assert(out1.size() == out2.size());
+
+    index2_t const size = out1.size();
+    index_t const stride = out1.stride();
+    T const max = std::numeric_limits<T>::max();
+
+    std::array<Image<T>*, 2> const out { &out1, &out2 };
+
+    auto const foreground = [&](u8 cls, index_t i) -> bool {
+        return cls == 0 ? bin1(i) : bin2(i);
+    };
+
+    // calls f with the step to and the stride of every neighbour of (x, y)
+    auto const neighbours = [&](index_t x, index_t y, auto const& f) {
+        using wdt::impl::Step;
+
+        bool const l = x > 0;
+        bool const r = x < size.x - 1;
+        bool const t = y > 0;
+        bool const b = y < size.y - 1;
+
+        if (l)
+            f(Step<-1, 0>{}, -1);
+        if (r)
+            f(Step<1, 0>{}, 1);
+        if (t)
+            f(Step<0, -1>{}, -stride);
+        if (b)
+            f(Step<0, 1>{}, stride);
+
+        if constexpr (N == 8) {
+            if (t && l)
+                f(Step<-1, -1>{}, -stride - 1);
+            if (t && r)
+                f(Step<1, -1>{}, -stride + 1);
+            if (b && l)
+                f(Step<-1, 1>{}, stride - 1);
+            if (b && r)
+                f(Step<1, 1>{}, stride + 1);
+        }
+    };
+
+    // step 1: initialize output, queue all non-masked pixels next to a foreground pixel
+    for (index_t y = 0, i = 0; y < size.y; ++y) {
+        for (index_t x = 0; x < size.x; ++x, ++i) {
+            bool const fg1 = bin1(i);
+            bool const fg2 = bin2(i);
+
+            out1[i] = fg1 ? static_cast<T>(0) : max;
+            out2[i] = fg2 ? static_cast<T>(0) : max;
+
+            if ((fg1 && fg2) || !mask(i))
+                continue;
+
+            std::array<T, 2> c { max, max };
+
+            // the cost of the step from the neighbour to this pixel
+            neighbours(x, y, [&](auto step, index_t s) {
+                using S = decltype(step);
+
+                for (u8 cls = 0; cls < 2; ++cls) {
+                    if (!foreground(cls, i + s))
+                        continue;
+
+                    auto const c_step = cost.template get_cost<-S::dx, -S::dy>(i + s);
+                    c[cls] = std::min(c[cls], c_step);
+                }
+            });
+
+            if (!fg1 && c[0] < limit)
+                q.push({ i, c[0], 0 });
+
+            if (!fg2 && c[1] < limit)
+                q.push({ i, c[1], 1 });
+        }
+    }
+
+    // step 2: while queue is not empty, get next pixel, write down cost, and add neighbors
+    while (!q.empty()) {
+        auto const pixel = q.top();
+        q.pop();
+
+        Image<T>& dist = *out[pixel.cls];
+
+        // check if someone has been here before; if so, skip this one
+        if (dist[pixel.idx] <= pixel.cost)
+            continue;
+
+        dist[pixel.idx] = pixel.cost;
+
+        auto const [x, y] = Image<T>::unravel(size, pixel.idx);
+
+        neighbours(x, y, [&](auto step, index_t s) {
+            using S = decltype(step);
+
+            index_t const j = pixel.idx + s;
+
+            if (foreground(pixel.cls, j) || !mask(j))
+                return;
+
+            auto const c = pixel.cost + cost.template get_cost<S::dx, S::dy>(pixel.idx);
+
+            if (c < dist[j] && c < limit) {
+                q.push({ j, c, pixel.cls });
+            }
+        });
+    }
+}
+
 } /* namespace iptsd::contacts::advanced::alg */
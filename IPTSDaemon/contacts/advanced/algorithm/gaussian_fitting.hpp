@@ -14,7 +14,10 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <limits>
 
 using namespace iptsd::container;
 using namespace iptsd::math;
@@ -57,10 +60,26 @@ auto gaussian_like(Vec2<T> x, Vec2<T> mean, Mat2s<T> prec) -> T
 }
 
 
+/*
+ * Assembles the normal equations of the weighted least-squares fit of
+ * log(d) = chi[0] x^2 + 2 chi[1] xy + chi[2] y^2 + chi[3] x + chi[4] y + chi[5].
+ *
+ * Every entry of the matrix is a weighted moment sum(d^2 x^i y^j) with i + j <= 4, and every
+ * entry of the right-hand side a moment sum(d^2 log(d) x^i y^j) with i + j <= 2, so only those
+ * 15 + 6 sums are accumulated. Within a row y is constant, so the rows are reduced to sums over
+ * powers of x first, which are then combined with the powers of y.
+ *
+ * The matrix is symmetric, in exchange its solution has 2 chi[1] as second component.
+ */
 template<class T, class S>
 inline void assemble_system(Mat6<S>& m, Vec6<S>& rhs, BBox const& b, Image<T> const& data,
                             Image<S> const& w)
 {
+    constexpr index_t chunk = 16;
+
+    // the exponents of x and y of the six terms of the polynomial
+    constexpr std::array<index2_t, 6> terms {{ {2, 0}, {1, 1}, {0, 2}, {1, 0}, {0, 1}, {0, 0} }};
+
     auto const eps = std::numeric_limits<S>::epsilon();
 
     auto const scale = Vec2<S> {
@@ -68,74 +87,70 @@ inline void assemble_system(Mat6<S>& m, Vec6<S>& rhs, BBox const& b, Image<T> co
         static_cast<S>(2) * range<S>.y / static_cast<S>(data.size().y),
     };
 
-    std::fill(m.data.begin(), m.data.end(), math::num<T>::zero);
-    std::fill(rhs.data.begin(), rhs.data.end(), math::num<T>::zero);
+    // mm[i][j] = sum(d^2 x^i y^j), mv[i][j] = sum(d^2 log(d) x^i y^j)
+    std::array<std::array<S, 5>, 5> mm {};
+    std::array<std::array<S, 3>, 3> mv {};
+
+    std::array<S, chunk> dd;
+    std::array<S, chunk> vv;
 
     for (index_t iy = b.ymin; iy <= b.ymax; ++iy) {
-        for (index_t ix = b.xmin; ix <= b.xmax; ++ix) {
-            auto const x = static_cast<S>(ix) * scale.x - range<S>.x;
-            auto const y = static_cast<S>(iy) * scale.y - range<S>.y;
-
-            auto const d = w[{ix - b.xmin, iy - b.ymin}] * static_cast<S>(data[{ix, iy}]);
-            auto const v = std::log(d + eps) * d * d;
-
-            rhs[0] += v * x * x;
-            rhs[1] += v * x * y;
-            rhs[2] += v * y * y;
-            rhs[3] += v * x;
-            rhs[4] += v * y;
-            rhs[5] += v;
-
-            m[{0, 0}] += d * d * x * x * x * x;
-            m[{0, 1}] += d * d * x * x * x * y;
-            m[{0, 2}] += d * d * x * x * y * y;
-            m[{0, 3}] += d * d * x * x * x;
-            m[{0, 4}] += d * d * x * x * y;
-            m[{0, 5}] += d * d * x * x;
-
-            m[{1, 0}] += d * d * x * x * x * y;
-            m[{1, 1}] += d * d * x * x * y * y;
-            m[{1, 2}] += d * d * x * y * y * y;
-            m[{1, 3}] += d * d * x * x * y;
-            m[{1, 4}] += d * d * x * y * y;
-            m[{1, 5}] += d * d * x * y;
-
-            m[{2, 0}] += d * d * x * x * y * y;
-            m[{2, 1}] += d * d * x * y * y * y;
-            m[{2, 2}] += d * d * y * y * y * y;
-            m[{2, 3}] += d * d * x * y * y;
-            m[{2, 4}] += d * d * y * y * y;
-            m[{2, 5}] += d * d * y * y;
-
-            m[{3, 0}] += d * d * x * x * x;
-            m[{3, 1}] += d * d * x * x * y;
-            m[{3, 2}] += d * d * x * y * y;
-            m[{3, 3}] += d * d * x * x;
-            m[{3, 4}] += d * d * x * y;
-            m[{3, 5}] += d * d * x;
-
-            m[{4, 0}] += d * d * x * x * y;
-            m[{4, 1}] += d * d * x * y * y;
-            m[{4, 2}] += d * d * y * y * y;
-            m[{4, 3}] += d * d * x * y;
-            m[{4, 4}] += d * d * y * y;
-            m[{4, 5}] += d * d * y;
-
-            m[{5, 0}] += d * d * x * x;
-            m[{5, 1}] += d * d * x * y;
-            m[{5, 2}] += d * d * y * y;
-            m[{5, 3}] += d * d * x;
-            m[{5, 4}] += d * d * y;
-            m[{5, 5}] += d * d;
+        T const* drow = &data[{0, iy}];
+        S const* wrow = &w[{0, iy - b.ymin}];
+
+        // sx[k] = sum(d^2 x^k), sv[k] = sum(d^2 log(d) x^k) over the row
+        std::array<S, 5> sx {};
+        std::array<S, 3> sv {};
+
+        for (index_t x0 = b.xmin; x0 <= b.xmax; x0 += chunk) {
+            index_t const n = std::min(chunk, b.xmax + 1 - x0);
+
+            for (index_t i = 0; i < n; ++i) {
+                auto const d = wrow[x0 - b.xmin + i] * static_cast<S>(drow[x0 + i]);
+
+                dd[i] = d * d;
+                vv[i] = std::log(d + eps) * d * d;
+            }
+
+            for (index_t i = 0; i < n; ++i) {
+                auto const x = static_cast<S>(x0 + i) * scale.x - range<S>.x;
+                auto const x2 = x * x;
+
+                sx[0] += dd[i];
+                sx[1] += dd[i] * x;
+                sx[2] += dd[i] * x2;
+                sx[3] += dd[i] * x2 * x;
+                sx[4] += dd[i] * x2 * x2;
+
+                sv[0] += vv[i];
+                sv[1] += vv[i] * x;
+                sv[2] += vv[i] * x2;
+            }
+        }
+
+        auto const y = static_cast<S>(iy) * scale.y - range<S>.y;
+        auto const py = std::array<S, 5> { math::num<S>::one, y, y * y, y * y * y, y * y * y * y };
+
+        for (index_t i = 0; i < 5; ++i) {
+            for (index_t j = 0; i + j < 5; ++j) {
+                mm[i][j] += sx[i] * py[j];
+            }
+        }
+
+        for (index_t i = 0; i < 3; ++i) {
+            for (index_t j = 0; i + j < 3; ++j) {
+                mv[i][j] += sv[i] * py[j];
+            }
         }
     }
 
-    m[{0, 1}] *= static_cast<S>(2);
-    m[{1, 1}] *= static_cast<S>(2);
-    m[{2, 1}] *= static_cast<S>(2);
-    m[{3, 1}] *= static_cast<S>(2);
-    m[{4, 1}] *= static_cast<S>(2);
-    m[{5, 1}] *= static_cast<S>(2);
+    for (index_t r = 0; r < 6; ++r) {
+        for (index_t c = 0; c < 6; ++c) {
+            m[{r, c}] = mm[terms[r].x + terms[c].x][terms[r].y + terms[c].y];
+        }
+
+        rhs[r] = mv[terms[r].x][terms[r].y];
+    }
 }
 
 template<class T>
@@ -283,13 +298,16 @@ void fit(std::vector<Parameters<S>>& params, Image<T> const& data,
             // assemble system of linear equations
             impl::assemble_system(sys, rhs, p.bounds, data, p.weights);
 
-            // solve systems
-            p.valid = math::ge_solve(sys, rhs, chi, eps);
+            // solve systems, fall back to pivoting if the matrix is (numerically) singular
+            p.valid = math::ldlt_solve(sys, rhs, chi, eps) || math::ge_solve(sys, rhs, chi, eps);
             if (!p.valid) {
                 spdlog::warn("invalid equation system");
                 continue;
             }
 
+            // the symmetric system solves for 2 chi[1]
+            chi[1] /= static_cast<S>(2);
+
             // get parameters
             p.valid = impl::extract_params(chi, p.scale, p.mean, p.prec, eps);
             if (!p.valid) {
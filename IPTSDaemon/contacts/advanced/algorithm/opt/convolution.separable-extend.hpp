@@ -0,0 +1,201 @@
+/*
+ * Optimized version of convolution.hpp. Do not include directly.
+ */
+
+#pragma once
+
+#include <common/types.hpp>
+
+#include <container/image.hpp>
+#include <container/kernel.hpp>
+
+#include <math/num.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+using namespace iptsd::container;
+using namespace iptsd::math;
+
+namespace iptsd::contacts::advanced::alg::conv::impl {
+
+/*
+ * The scalar type of a pixel, and how many of them it consists of. Pixels like Mat2s<f32>
+ * are processed as a flat array of their components, so both passes run over plain f32 rows.
+ */
+template<typename T, typename = void>
+struct components {
+    using type = T;
+};
+
+template<typename T>
+struct components<T, std::void_t<typename T::value_type>> {
+    using type = typename T::value_type;
+};
+
+// A 1D kernel, as a non-deduced parameter next to the 2D kernel or image it belongs to.
+template<typename S, index_t N>
+using Kernel1d = std::array<S, static_cast<std::size_t>(N)>;
+
+// The width of the strips in which images are processed.
+inline constexpr index_t strip = 64;
+
+template<typename T, typename S>
+inline constexpr bool is_flat_v = std::is_same_v<typename components<T>::type, S>
+    && std::is_standard_layout_v<T> && std::is_trivially_copyable_v<T>
+    && sizeof(T) % sizeof(S) == 0;
+
+
+/*
+ * Splits a kernel into a horizontal and a vertical 1D kernel, if it is the outer product of
+ * the two (e.g. a gaussian). The 1D kernels are the sums over the columns and the rows.
+ */
+template<typename S, index_t Nx, index_t Ny>
+auto separate(Kernel<S, Nx, Ny> const& k, Kernel1d<S, Nx>& kx, Kernel1d<S, Ny>& ky) -> bool
+{
+    kx.fill(math::num<S>::zero);
+    ky.fill(math::num<S>::zero);
+
+    S sum = math::num<S>::zero;
+    S max = math::num<S>::zero;
+
+    for (index_t y = 0; y < Ny; ++y) {
+        for (index_t x = 0; x < Nx; ++x) {
+            kx[x] += k[{x, y}];
+            ky[y] += k[{x, y}];
+            sum += k[{x, y}];
+            max = std::max(max, std::abs(k[{x, y}]));
+        }
+    }
+
+    if (std::abs(sum) <= max * static_cast<S>(1e-3))
+        return false;
+
+    for (auto& v : ky)
+        v /= sum;
+
+    // only rank-1 kernels give back the original kernel
+    S const tolerance = max * std::numeric_limits<S>::epsilon() * 16;
+
+    for (index_t y = 0; y < Ny; ++y) {
+        for (index_t x = 0; x < Nx; ++x) {
+            if (std::abs(kx[x] * ky[y] - k[{x, y}]) > tolerance)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+
+/*
+ * Convolution with a separable kernel and extended borders: every row is first filtered
+ * vertically into a small buffer, which is then filtered horizontally into the output.
+ *
+ * The image is processed in strips, so the buffer has a fixed size. Both passes run over
+ * contiguous memory without any branches, so that the compiler can vectorize them.
+ */
+template<typename T, typename S, index_t Nx, index_t Ny>
+void conv_separable_strip(S* out, Image<T> const& data, index_t y, index_t x0, index_t x1,
+                          Kernel1d<S, Nx> const& kx, Kernel1d<S, Ny> const& ky)
+{
+    static_assert(is_flat_v<T, S>);
+
+    constexpr index_t c = sizeof(T) / sizeof(S);
+    constexpr index_t rx = (Nx - 1) / 2;
+    constexpr index_t ry = (Ny - 1) / 2;
+
+    std::array<S, (strip + 2 * rx) * c> buf;
+
+    index2_t const size = data.size();
+    S const* src = reinterpret_cast<S const*>(data.data());
+
+    std::array<S const*, Ny> rows;
+
+    for (index_t j = 0; j < Ny; ++j)
+        rows[j] = src + std::clamp(y - ry + j, 0, size.y - 1) * size.x * c;
+
+    // the columns that are read, and the part of them that is inside the image
+    index_t const b0 = x0 - rx;
+    index_t const i0 = std::max(b0, 0);
+    index_t const i1 = std::min(x1 + rx, size.x);
+
+    // vertical pass
+    for (index_t i = i0 * c; i < i1 * c; ++i) {
+        S v = math::num<S>::zero;
+
+        for (index_t j = 0; j < Ny; ++j)
+            v += rows[j][i] * ky[j];
+
+        buf[i - b0 * c] = v;
+    }
+
+    // extend the first and last column
+    for (index_t x = b0; x < i0; ++x)
+        std::copy_n(&buf[(i0 - b0) * c], c, &buf[(x - b0) * c]);
+
+    for (index_t x = i1; x < x1 + rx; ++x)
+        std::copy_n(&buf[(i1 - 1 - b0) * c], c, &buf[(x - b0) * c]);
+
+    // horizontal pass
+    for (index_t i = 0; i < (x1 - x0) * c; ++i) {
+        S v = math::num<S>::zero;
+
+        for (index_t j = 0; j < Nx; ++j)
+            v += buf[i + j * c] * kx[j];
+
+        out[i] = v;
+    }
+}
+
+template<typename T, typename S, index_t Nx, index_t Ny>
+void conv_separable_extend(Image<T>& out, Image<T> const& data,
+                           Kernel1d<S, Nx> const& kx, Kernel1d<S, Ny> const& ky)
+{
+    constexpr index_t c = sizeof(T) / sizeof(S);
+
+    index2_t const size = data.size();
+    S* dst = reinterpret_cast<S*>(out.data());
+
+    for (index_t y = 0; y < size.y; ++y) {
+        for (index_t x0 = 0; x0 < size.x; x0 += strip) {
+            index_t const x1 = std::min(x0 + strip, size.x);
+
+            S* row = dst + (y * size.x + x0) * c;
+
+            conv_separable_strip<T, S, Nx, Ny>(row, data, y, x0, x1, kx, ky);
+        }
+    }
+}
+
+/*
+ * Like conv_separable_extend, but stores f of every result instead. The results only pass
+ * through a buffer of one strip, instead of a whole image.
+ */
+template<typename T, typename U, typename S, index_t Nx, index_t Ny, typename F>
+void conv_separable_extend(Image<U>& out, Image<T> const& data,
+                           Kernel1d<S, Nx> const& kx, Kernel1d<S, Ny> const& ky, F const& f)
+{
+    std::array<T, strip> line;
+
+    index2_t const size = data.size();
+
+    for (index_t y = 0; y < size.y; ++y) {
+        for (index_t x0 = 0; x0 < size.x; x0 += strip) {
+            index_t const x1 = std::min(x0 + strip, size.x);
+
+            conv_separable_strip<T, S, Nx, Ny>(reinterpret_cast<S*>(line.data()), data, y, x0, x1,
+                                               kx, ky);
+
+            U* row = &out[{x0, y}];
+
+            for (index_t i = 0; i < x1 - x0; ++i)
+                row[i] = f(line[i]);
+        }
+    }
+}
+
+} /* namespace iptsd::contacts::advanced::alg::conv::impl */
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <common/types.hpp>
+
+#include "convolution.hpp"
+
+#include <container/image.hpp>
+#include <container/kernel.hpp>
+
+#include <math/num.hpp>
+#include <math/mat2.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace iptsd::container;
+using namespace iptsd::math;
+
+
+namespace iptsd::contacts::advanced::alg {
+
+/*
+ * An image of symmetric 2x2 matrices, like Image<Mat2s<T>>, but stored as three separate
+ * planes. Every plane is a plain image of scalars, so operations over all pixels can run on
+ * contiguous rows instead of picking the components out of interleaved matrices.
+ */
+template<typename T>
+struct TensorImage {
+    Image<T> xx;
+    Image<T> xy;
+    Image<T> yy;
+
+    TensorImage() = default;
+    TensorImage(index2_t size);
+
+    [[nodiscard]] auto size() const -> index2_t;
+    void resize(index2_t size);
+
+    [[nodiscard]] auto operator[](index_t i) const -> Mat2s<T>;
+};
+
+template<typename T>
+TensorImage<T>::TensorImage(index2_t size) : xx{size}, xy{size}, yy{size}
+{}
+
+template<typename T>
+inline auto TensorImage<T>::size() const -> index2_t
+{
+    return xx.size();
+}
+
+template<typename T>
+inline void TensorImage<T>::resize(index2_t size)
+{
+    xx.resize(size);
+    xy.resize(size);
+    yy.resize(size);
+}
+
+template<typename T>
+inline auto TensorImage<T>::operator[](index_t i) const -> Mat2s<T>
+{
+    return { xx[i], xy[i], yy[i] };
+}
+
+
+namespace tensor::impl {
+
+template<typename T>
+void eigenvalues_scalar(T const* xx, T const* xy, T const* yy, T* ev1, T* ev2, index_t n)
+{
+    for (index_t i = 0; i < n; ++i) {
+        T const h = (xx[i] + yy[i]) / 2;
+        T const d = (xx[i] - yy[i]) / 2;
+        T const q = std::sqrt(d * d + xy[i] * xy[i]);
+
+        T const r1 = h + std::copysign(q, h);
+        T const det = xx[i] * yy[i] - xy[i] * xy[i];
+
+        ev1[i] = r1;
+        ev2[i] = r1 != math::num<T>::zero ? det / r1 : math::num<T>::zero;
+    }
+}
+
+} /* namespace tensor::impl */
+
+
+/*
+ * Computes the eigenvalues of n symmetric matrices, given as rows of their components.
+ * Like Mat2s::eigenvalues(), ev1 is the one with the larger magnitude and ev2 is derived
+ * from the determinant, but the discriminant is computed so that it can't become negative.
+ */
+template<typename T>
+void eigenvalues(T const* xx, T const* xy, T const* yy, T* ev1, T* ev2, index_t n)
+{
+    index_t i = 0;
+
+#if defined(__SSE2__)
+    if constexpr (std::is_same_v<T, f32>) {
+        __m128 const half = _mm_set1_ps(0.5f);
+        __m128 const sign = _mm_set1_ps(-0.0f);
+        __m128 const zero = _mm_setzero_ps();
+
+        for (; i + 4 <= n; i += 4) {
+            __m128 const a = _mm_loadu_ps(xx + i);
+            __m128 const b = _mm_loadu_ps(xy + i);
+            __m128 const c = _mm_loadu_ps(yy + i);
+
+            __m128 const h = _mm_mul_ps(_mm_add_ps(a, c), half);
+            __m128 const d = _mm_mul_ps(_mm_sub_ps(a, c), half);
+            __m128 const q = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(d, d), _mm_mul_ps(b, b)));
+
+            // r1 = h + copysign(q, h)
+            __m128 const r1 = _mm_add_ps(h, _mm_or_ps(q, _mm_and_ps(h, sign)));
+            __m128 const det = _mm_sub_ps(_mm_mul_ps(a, c), _mm_mul_ps(b, b));
+            __m128 const r2 = _mm_and_ps(_mm_div_ps(det, r1), _mm_cmpneq_ps(r1, zero));
+
+            _mm_storeu_ps(ev1 + i, r1);
+            _mm_storeu_ps(ev2 + i, r2);
+        }
+    }
+#endif
+
+    tensor::impl::eigenvalues_scalar(xx + i, xy + i, yy + i, ev1 + i, ev2 + i, n - i);
+}
+
+
+/*
+ * Smooths the tensors with k (with extended borders) and stores the eigenvalues of the
+ * result. The smoothed tensors are only kept for one strip of a row at a time.
+ */
+template<typename T, index_t Nx, index_t Ny>
+void smoothed_eigenvalues(Image<T>& ev1, Image<T>& ev2, TensorImage<T> const& in,
+                          Kernel<T, Nx, Ny> const& k)
+{
+    using conv::impl::strip;
+
+    assert(in.size() == ev1.size());
+    assert(in.size() == ev2.size());
+
+    conv::impl::Kernel1d<T, Nx> kx;
+    conv::impl::Kernel1d<T, Ny> ky;
+
+    bool const separable = conv::impl::separate(k, kx, ky);
+
+    std::array<T, strip> xx;
+    std::array<T, strip> xy;
+    std::array<T, strip> yy;
+
+    // fallback for kernels that are not separable
+    auto const pixel = [&](Image<T> const& plane, index_t cx, index_t cy) -> T {
+        T v = math::num<T>::zero;
+
+        for (index_t iy = 0; iy < Ny; ++iy) {
+            for (index_t ix = 0; ix < Nx; ++ix) {
+                index2_t const p { cx - (Nx - 1) / 2 + ix, cy - (Ny - 1) / 2 + iy };
+                v += border::Extend::value(plane, p) * k[{ix, iy}];
+            }
+        }
+
+        return v;
+    };
+
+    index2_t const size = in.size();
+
+    for (index_t y = 0; y < size.y; ++y) {
+        for (index_t x0 = 0; x0 < size.x; x0 += strip) {
+            index_t const x1 = std::min(x0 + strip, size.x);
+
+            auto const smooth = [&](T* out, Image<T> const& plane) {
+                if (separable) {
+                    conv::impl::conv_separable_strip<T, T, Nx, Ny>(out, plane, y, x0, x1, kx, ky);
+                    return;
+                }
+
+                for (index_t x = x0; x < x1; ++x)
+                    out[x - x0] = pixel(plane, x, y);
+            };
+
+            smooth(xx.data(), in.xx);
+            smooth(xy.data(), in.xy);
+            smooth(yy.data(), in.yy);
+
+            eigenvalues(xx.data(), xy.data(), yy.data(), &ev1[{x0, y}], &ev2[{x0, y}], x1 - x0);
+        }
+    }
+}
+
+} /* namespace iptsd::contacts::advanced::alg */
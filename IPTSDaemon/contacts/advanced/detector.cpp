@@ -6,17 +6,13 @@
 
 #include "detector.hpp"
 
-#include "../neutral.hpp"
-
 #include <common/types.hpp>
 
 #include "algorithm/convolution.hpp"
+#include "algorithm/derivatives.hpp"
 #include "algorithm/distance_transform.hpp"
 #include "algorithm/gaussian_fitting.hpp"
-#include "algorithm/hessian.hpp"
 #include "algorithm/label.hpp"
-#include "algorithm/local_maxima.hpp"
-#include "algorithm/structure_tensor.hpp"
 
 #include <container/image.hpp>
 #include <container/kernel.hpp>
@@ -29,9 +25,9 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <array>
 #include <vector>
-#include <queue>
 
 using namespace iptsd::container;
 using namespace iptsd::math;
@@ -39,13 +35,23 @@ using namespace iptsd::math;
 
 namespace iptsd::contacts::advanced {
 
+// Distances above the limit are not computed. Every step of the distance transform costs
+// at least wdt_min_cost (see WdtCost), which is also the bucket width of its queue.
+static constexpr f32 wdt_limit = 6.0f;
+static constexpr f32 wdt_min_cost = 0.1f;
+
 BlobDetector::BlobDetector(index2_t size, BlobDetectorConfig config)
     : config{config}
+    , m_region{{0, 0}, size}
     , m_hm{size}
+    , m_img_roi{size}
     , m_img_pp{size}
-    , m_img_m2_1{size}
-    , m_img_m2_2{size}
-    , m_img_stev{size}
+    , m_img_st{size}
+    , m_img_hs{size}
+    , m_img_stev1{size}
+    , m_img_stev2{size}
+    , m_img_hsev1{size}
+    , m_img_hsev2{size}
     , m_img_rdg{size}
     , m_img_obj{size}
     , m_img_lbl{size}
@@ -53,7 +59,7 @@ BlobDetector::BlobDetector(index2_t size, BlobDetectorConfig config)
     , m_img_dm2{size}
     , m_img_flt{size}
     , m_img_gftmp{size}
-    , m_wdt_queue{}
+    , m_wdt_queue{wdt_limit, wdt_min_cost}
     , m_gf_params{}
     , m_maximas{32}
     , m_cstats{32}
@@ -64,24 +70,19 @@ BlobDetector::BlobDetector(index2_t size, BlobDetectorConfig config)
     , m_gf_window{11, 11}
     , m_touchpoints{}
 {
-    const std::less<alg::wdt::QItem<f32>> op {};
-    const std::vector<alg::wdt::QItem<f32>> buf {512};
-
-    m_wdt_queue = std::priority_queue { op, buf };
-
     alg::gfit::reserve(m_gf_params, 32, size);
 }
 
 class WdtCost {
 public:
-    WdtCost(Image<std::array<f32, 2>> const& m_img_stev_,
-        Image<f32> const& m_img_rdg_) : m_img_stev{m_img_stev_}
-    , m_img_rdg{m_img_rdg_} {}
+    WdtCost(Image<f32> const& m_img_stev1_, Image<f32> const& m_img_stev2_,
+        Image<f32> const& m_img_rdg_) : m_img_stev1{m_img_stev1_}
+    , m_img_stev2{m_img_stev2_}, m_img_rdg{m_img_rdg_} {}
 
     template<index_t DX, index_t DY>
     [[gnu::always_inline]] [[nodiscard]] f32 get_cost(index_t i) const
     {
-        f32 constexpr c_dist = 0.1f;
+        f32 constexpr c_dist = wdt_min_cost;
         f32 constexpr c_ridge = 9.0f;
         f32 constexpr c_grad = 1.0f;
 
@@ -90,7 +91,8 @@ public:
         // auto const dist = std::hypotf(gsl::narrow<f32>(d.x), gsl::narrow<f32>(d.y));
         f32 constexpr dist = DX * DY == 0 ? 1 : M_SQRT2;
 
-        auto const [ev1, ev2] = common::unchecked<std::array<f32, 2>>(m_img_stev.get(), i);
+        auto const ev1 = common::unchecked<f32>(m_img_stev1.get(), i);
+        auto const ev2 = common::unchecked<f32>(m_img_stev2.get(), i);
         auto const grad = std::max(ev1, 0.0f) + std::max(ev2, 0.0f);
         auto const ridge = common::unchecked<f32>(m_img_rdg.get(), i);
 
@@ -98,48 +100,82 @@ public:
     }
 
 private:
-    std::reference_wrapper<const Image<std::array<f32, 2>>> m_img_stev;
+    std::reference_wrapper<const Image<f32>> m_img_stev1;
+    std::reference_wrapper<const Image<f32>> m_img_stev2;
     std::reference_wrapper<const Image<f32>> m_img_rdg;
 };
 
+void BlobDetector::crop(Image<f32> const& hm, Region const& roi)
+{
+    auto const size = roi.size();
+
+    // resizing keeps the memory, so this doesn't allocate after the first full frame
+    m_img_roi.resize(size);
+    m_img_pp.resize(size);
+    m_img_st.resize(size);
+    m_img_hs.resize(size);
+    m_img_stev1.resize(size);
+    m_img_stev2.resize(size);
+    m_img_hsev1.resize(size);
+    m_img_hsev2.resize(size);
+    m_img_rdg.resize(size);
+    m_img_obj.resize(size);
+    m_img_lbl.resize(size);
+    m_img_dm1.resize(size);
+    m_img_dm2.resize(size);
+    m_img_flt.resize(size);
+    m_img_gftmp.resize(size);
+
+    for (index_t y = 0; y < size.y; ++y) {
+        auto const* src = &hm[index2_t { roi.min.x, roi.min.y + y }];
+        std::copy_n(src, size.x, &m_img_roi[index2_t { 0, y }]);
+    }
+}
+
 auto BlobDetector::process(Image<f32> const& hm) -> std::vector<Blob> const&
 {
+    // region of interest, everything below works on a copy of it
+    auto const roi = m_region.grow(region_margin, hm.size());
+    auto const offset = Vec2<f64> {
+        static_cast<f64>(roi.min.x),
+        static_cast<f64>(roi.min.y),
+    };
+
+    m_touchpoints.clear();
+    if (roi.empty()) {
+        return m_touchpoints;
+    }
+
+    crop(hm, roi);
+
     // preprocessing
     {
-        alg::convolve(m_img_pp, hm, m_kern_pp);
+        alg::convolve(m_img_pp, m_img_roi, m_kern_pp);
 
-        auto const nval = neutral(this->config, hm);
+        auto const nval = m_neutral;
 
         container::ops::transform(m_img_pp, [&](auto const x) {
             return std::max(x - nval, 0.0f);
         });
     }
 
-    // structure tensor
+    // structure tensor and hessian
     {
-        alg::structure_tensor(m_img_m2_1, m_img_pp);
-        alg::convolve(m_img_m2_2, m_img_m2_1, m_kern_st);
+        alg::structure_tensor_hessian(m_img_st, m_img_hs, m_img_pp);
     }
 
-    // eigenvalues of structure tensor
+    // eigenvalues of smoothed structure tensor
     {
-        container::ops::transform(m_img_m2_2, m_img_stev, [](auto const s) {
-            return s.eigenvalues();
-        });
+        alg::smoothed_eigenvalues(m_img_stev1, m_img_stev2, m_img_st, m_kern_st);
     }
 
-    // hessian
+    // ridge measure from smoothed hessian
     {
-        alg::hessian(m_img_m2_1, m_img_pp);
-        alg::convolve(m_img_m2_2, m_img_m2_1, m_kern_hs);
-    }
+        alg::smoothed_eigenvalues(m_img_hsev1, m_img_hsev2, m_img_hs, m_kern_hs);
 
-    // ridge measure
-    {
-        container::ops::transform(m_img_m2_2, m_img_rdg, [](auto h) {
-            auto const [ev1, ev2] = h.eigenvalues();
-            return std::max(ev1, 0.0f) + std::max(ev2, 0.0f);
-        });
+        for (index_t i = 0; i < m_img_rdg.size().span(); ++i) {
+            m_img_rdg[i] = std::max(m_img_hsev1[i], 0.0f) + std::max(m_img_hsev2[i], 0.0f);
+        }
     }
 
     // objective for labeling
@@ -157,7 +193,7 @@ auto BlobDetector::process(Image<f32> const& hm) -> std::vector<Blob> const&
         // TODO: We may want to compute local maximas with a different smoothing factor
 
         m_maximas.clear();
-        alg::find_local_maximas(m_img_pp, 0.05f, std::back_inserter(m_maximas));
+        m_maxima_finder.find(m_img_pp, maxima_threshold, m_maximas);
     }
 
     // labels
@@ -178,7 +214,8 @@ auto BlobDetector::process(Image<f32> const& hm) -> std::vector<Blob> const&
                 continue;
 
             auto const value = m_img_pp[i];
-            auto const [ev1, ev2] = m_img_stev[i];
+            auto const ev1 = m_img_stev1[i];
+            auto const ev2 = m_img_stev2[i];
 
             auto const coherence = ev1 + ev2 != 0.0f ? (ev1 - ev2) / (ev1 + ev2) : 1.0;
 
@@ -229,7 +266,7 @@ auto BlobDetector::process(Image<f32> const& hm) -> std::vector<Blob> const&
     // distance transform
     {
         auto const th_inc = 0.6f;
-        const WdtCost wdt_cost {m_img_stev, m_img_rdg};
+        const WdtCost wdt_cost {m_img_stev1, m_img_stev2, m_img_rdg};
 
         auto const wdt_mask = [&](index_t i) -> bool {
             return common::unchecked<f32>(m_img_pp, i) > 0.0f && common::unchecked<u16>(m_img_lbl, i) == 0;
@@ -245,8 +282,8 @@ auto BlobDetector::process(Image<f32> const& hm) -> std::vector<Blob> const&
             return lbl && common::unchecked<f32>(m_cscore, lbl - 1) <= th_inc;
         };
 
-        alg::weighted_distance_transform<4>(m_img_dm1, wdt_inc_bin, wdt_mask, wdt_cost, m_wdt_queue, 6.0f);
-        alg::weighted_distance_transform<4>(m_img_dm2, wdt_exc_bin, wdt_mask, wdt_cost, m_wdt_queue, 6.0f);
+        alg::weighted_distance_transform<4>(m_img_dm1, m_img_dm2, wdt_inc_bin, wdt_exc_bin, wdt_mask,
+                                            wdt_cost, m_wdt_queue, wdt_limit);
     }
 
     // filter
@@ -272,7 +309,7 @@ auto BlobDetector::process(Image<f32> const& hm) -> std::vector<Blob> const&
         // TODO: We may want to compute local maximas with a different smoothing factor
 
         m_maximas.clear();
-        alg::find_local_maximas(m_img_flt, 0.05f, std::back_inserter(m_maximas));
+        m_maxima_finder.find(m_img_flt, maxima_threshold, m_maximas);
     }
 
     // gaussian fitting
@@ -305,7 +342,6 @@ auto BlobDetector::process(Image<f32> const& hm) -> std::vector<Blob> const&
     }
 
     // generate output
-    m_touchpoints.clear();
     for (auto const& p : m_gf_params) {
         if (!p.valid) {
             continue;
@@ -326,7 +362,9 @@ auto BlobDetector::process(Image<f32> const& hm) -> std::vector<Blob> const&
             continue;
         }
 
-        m_touchpoints.push_back(Blob { p.mean + 0.5, cov.value() });
+        auto const mean = p.mean + 0.5 + offset;
+
+        m_touchpoints.push_back(Blob { mean.cast<scalar_t>(), cov->cast<scalar_t>() });
     }
 
     return m_touchpoints;
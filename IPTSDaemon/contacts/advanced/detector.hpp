@@ -4,18 +4,19 @@
 
 #include "algorithm/distance_transform.hpp"
 #include "algorithm/gaussian_fitting.hpp"
+#include "algorithm/tensor.hpp"
 
 #include <container/image.hpp>
 #include <container/kernel.hpp>
 
 #include <contacts/interface.hpp>
+#include <contacts/maxima.hpp>
 
 #include <math/vec2.hpp>
 #include <math/mat2.hpp>
 
 #include <array>
 #include <vector>
-#include <queue>
 
 using namespace iptsd::container;
 using namespace iptsd::math;
@@ -37,18 +38,36 @@ public:
 
     auto data() -> Image<f32> & override;
     auto search() -> std::vector<Blob> const& override;
+    void set_neutral(f32 value) override;
+    auto threshold() const -> f32 override;
+    void set_region(Region const& region) override;
+
+    // Local maxima of the preprocessed heatmap need to be above this to become a blob.
+    static constexpr f32 maxima_threshold = 0.05f;
 
 private:
     auto process(Image<f32> const& hm) -> std::vector<Blob> const&;
+    void crop(Image<f32> const& hm, Region const& roi);
+
+    // Pixels around the active region that are processed as well. The preprocessing and
+    // the structure tensor / hessian kernels spread every pixel by 4 in total, the rest
+    // is headroom for the distance transform and the gaussian fitting window.
+    static constexpr index_t region_margin = 8;
 
     BlobDetectorConfig config;
+    f32 m_neutral = 0;
+    Region m_region;
 
     // temporary storage
     Image<f32> m_hm;
+    Image<f32> m_img_roi;
     Image<f32> m_img_pp;
-    Image<Mat2s<f32>> m_img_m2_1;
-    Image<Mat2s<f32>> m_img_m2_2;
-    Image<std::array<f32, 2>> m_img_stev;
+    alg::TensorImage<f32> m_img_st;
+    alg::TensorImage<f32> m_img_hs;
+    Image<f32> m_img_stev1;
+    Image<f32> m_img_stev2;
+    Image<f32> m_img_hsev1;
+    Image<f32> m_img_hsev2;
     Image<f32> m_img_rdg;
     Image<f32> m_img_obj;
     Image<u16> m_img_lbl;
@@ -57,9 +76,10 @@ private:
     Image<f32> m_img_flt;
     Image<f64> m_img_gftmp;
 
-    std::priority_queue<alg::wdt::QItem<f32>> m_wdt_queue;
+    alg::wdt::BucketQueue<alg::wdt::ClassItem<f32>> m_wdt_queue;
     std::vector<alg::gfit::Parameters<f64>> m_gf_params;
 
+    LocalMaxima m_maxima_finder;
     std::vector<index_t> m_maximas;
     std::vector<ComponentStats> m_cstats;
     std::vector<f32> m_cscore;
@@ -81,6 +101,23 @@ inline auto BlobDetector::data() -> Image<f32> &
     return m_hm;
 }
 
+inline void BlobDetector::set_neutral(f32 value)
+{
+    m_neutral = value;
+}
+
+inline auto BlobDetector::threshold() const -> f32
+{
+    // The preprocessing kernel is normalized, and the filtered image is a weighted
+    // copy of the preprocessed one. Neither can exceed the maximum of the heatmap.
+    return m_neutral + maxima_threshold;
+}
+
+inline void BlobDetector::set_region(Region const& region)
+{
+    m_region = region;
+}
+
 inline auto BlobDetector::search() -> std::vector<Blob> const&
 {
 	return this->process(this->m_hm);
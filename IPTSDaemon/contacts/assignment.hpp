@@ -0,0 +1,230 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_CONTACTS_ASSIGNMENT_HPP
+#define IPTSD_CONTACTS_ASSIGNMENT_HPP
+
+#include <common/types.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+namespace iptsd::contacts {
+
+/*
+ * Solves the assignment problem for up to N rows and N columns: Every row is matched
+ * with a different column (or every column with a different row, if there are less of them),
+ * so that the sum of the costs of all matches is as small as possible. T is the type of the costs.
+ *
+ * This is the Hungarian method with row and column potentials, which needs O(n² * m) steps
+ * for n rows and m columns. All storage has a fixed size, so solving doesn't allocate.
+ *
+ * Costs that are NaN or infinite are replaced by a finite cost that is higher than that of any
+ * assignment without them, so those pairs are only matched if there is no other way.
+ */
+template <class T, std::size_t N> class Assignment {
+public:
+	static constexpr u32 none = std::numeric_limits<u32>::max();
+
+private:
+	static constexpr T inf = std::numeric_limits<T>::infinity();
+
+	// The largest cost that non-finite costs are replaced with, leaving room for the potentials.
+	static constexpr T max_cost = std::numeric_limits<T>::max() / (4 * N);
+
+	u32 rows = 0;
+	u32 cols = 0;
+
+	std::array<T, N * N> costs {};
+	std::array<u32, N> matches {};
+
+	// Scratch space, indexed from 1 with 0 as a virtual column.
+	std::array<T, N + 1> u {};
+	std::array<T, N + 1> v {};
+	std::array<T, N + 1> minv {};
+	std::array<u32, N + 1> p {};
+	std::array<u32, N + 1> way {};
+	std::array<bool, N + 1> used {};
+
+public:
+	void resize(u32 rows, u32 cols);
+
+	T &cost(u32 row, u32 col);
+	void solve();
+
+	// The column that a row was matched with, or none.
+	[[nodiscard]] u32 match(u32 row) const;
+
+private:
+	static bool finite(T value);
+
+	void sanitize();
+	template <bool Transposed> void hungarian(u32 n, u32 m);
+};
+
+template <class T, std::size_t N> inline void Assignment<T, N>::resize(u32 rows, u32 cols)
+{
+	assert(rows <= N && cols <= N);
+
+	this->rows = rows;
+	this->cols = cols;
+}
+
+template <class T, std::size_t N> inline T &Assignment<T, N>::cost(u32 row, u32 col)
+{
+	return this->costs[row * N + col];
+}
+
+template <class T, std::size_t N> inline u32 Assignment<T, N>::match(u32 row) const
+{
+	return this->matches[row];
+}
+
+template <class T, std::size_t N> inline void Assignment<T, N>::solve()
+{
+	this->matches.fill(none);
+
+	if (this->rows == 0 || this->cols == 0)
+		return;
+
+	// A NaN cost is never smaller than anything, so no augmenting path could be found
+	this->sanitize();
+
+	// The method needs at least as many columns as rows
+	if (this->rows <= this->cols)
+		this->hungarian<false>(this->rows, this->cols);
+	else
+		this->hungarian<true>(this->cols, this->rows);
+}
+
+/*
+ * Like std::isfinite(), but it checks the bits. Fast math lets the compiler assume that
+ * there are no NaNs or infinities, and std::isfinite() can be optimized out.
+ */
+template <class T, std::size_t N> inline bool Assignment<T, N>::finite(T value)
+{
+	using U = std::conditional_t<sizeof(T) == sizeof(u32), u32, u64>;
+
+	// Infinity has all exponent bits set, and nothing else
+	constexpr U exponent = std::bit_cast<U>(std::numeric_limits<T>::infinity());
+
+	return (std::bit_cast<U>(value) & exponent) != exponent;
+}
+
+template <class T, std::size_t N> inline void Assignment<T, N>::sanitize()
+{
+	T max = 0;
+	bool valid = true;
+
+	for (u32 i = 0; i < this->rows; i++) {
+		for (u32 j = 0; j < this->cols; j++) {
+			const T cost = this->costs[i * N + j];
+
+			if (finite(cost))
+				max = std::max(max, std::abs(cost));
+			else
+				valid = false;
+		}
+	}
+
+	if (valid)
+		return;
+
+	// Any assignment with a replaced cost is more expensive than all assignments without
+	const T k = static_cast<T>(std::min(this->rows, this->cols));
+	const T replacement = max < max_cost / (2 * k + 1) ? 2 * k * max + 1 : max_cost;
+
+	for (u32 i = 0; i < this->rows; i++) {
+		for (u32 j = 0; j < this->cols; j++) {
+			T &cost = this->costs[i * N + j];
+
+			if (!finite(cost))
+				cost = replacement;
+		}
+	}
+}
+
+template <class T, std::size_t N>
+template <bool Transposed>
+inline void Assignment<T, N>::hungarian(u32 n, u32 m)
+{
+	const auto a = [&](u32 i, u32 j) {
+		return Transposed ? this->costs[j * N + i] : this->costs[i * N + j];
+	};
+
+	std::fill_n(this->u.begin(), n + 1, T {0});
+	std::fill_n(this->v.begin(), m + 1, T {0});
+	std::fill_n(this->p.begin(), m + 1, 0);
+	std::fill_n(this->way.begin(), m + 1, 0);
+
+	for (u32 i = 1; i <= n; i++) {
+		// Find an augmenting path for row i, starting at the virtual column 0
+		this->p[0] = i;
+		u32 j0 = 0;
+
+		std::fill_n(this->minv.begin(), m + 1, inf);
+		std::fill_n(this->used.begin(), m + 1, false);
+
+		do {
+			this->used[j0] = true;
+
+			const u32 i0 = this->p[j0];
+			T delta = inf;
+			u32 j1 = 0;
+
+			for (u32 j = 1; j <= m; j++) {
+				if (this->used[j])
+					continue;
+
+				const T cur = a(i0 - 1, j - 1) - this->u[i0] - this->v[j];
+
+				if (cur < this->minv[j]) {
+					this->minv[j] = cur;
+					this->way[j] = j0;
+				}
+
+				if (this->minv[j] < delta) {
+					delta = this->minv[j];
+					j1 = j;
+				}
+			}
+
+			for (u32 j = 0; j <= m; j++) {
+				if (this->used[j]) {
+					this->u[this->p[j]] += delta;
+					this->v[j] -= delta;
+				} else {
+					this->minv[j] -= delta;
+				}
+			}
+
+			j0 = j1;
+		} while (this->p[j0] != 0);
+
+		// Flip the matches along the path
+		do {
+			const u32 j1 = this->way[j0];
+			this->p[j0] = this->p[j1];
+			j0 = j1;
+		} while (j0 != 0);
+	}
+
+	for (u32 j = 1; j <= m; j++) {
+		if (this->p[j] == 0)
+			continue;
+
+		if (Transposed)
+			this->matches[j - 1] = this->p[j] - 1;
+		else
+			this->matches[this->p[j] - 1] = j - 1;
+	}
+}
+
+} /* namespace iptsd::contacts */
+
+#endif /* IPTSD_CONTACTS_ASSIGNMENT_HPP */
@@ -4,118 +4,147 @@
 
 #include "cluster.hpp"
 
+#include "../advanced/algorithm/label.hpp"
+
 #include <common/types.hpp>
 
+#include <algorithm>
+#include <cstddef>
+#include <gsl/gsl>
 #include <limits>
+#include <stdexcept>
 
 namespace iptsd::contacts::basic::algorithms {
 
-void find_local_maximas(const container::Image<f32> &data, const f32 threshold,
-			std::vector<index2_t> &out)
+Cluster<scalar_t> span_cluster(const container::Image<f32> &data, const f32 athresh,
+			       const f32 dthresh, const index2_t center, VisitedMap &visited,
+			       std::vector<ClusterSeed> &stack)
 {
-	/*
-	 * We use the following kernel to compare entries:
-	 *
-	 *   [< ] [< ] [< ]
-	 *   [< ] [  ] [<=]
-	 *   [<=] [<=] [<=]
-	 *
-	 * Half of the entries use "less or equal", the other half "less than" as
-	 * operators to ensure that we don't either discard any local maximas or
-	 * report some multiple times.
-	 */
-
 	const index2_t size = data.size();
 
-	for (index_t x = 0; x < size.x; x++) {
-		for (index_t y = 0; y < size.y; y++) {
-			const index2_t pos {x, y};
+	Cluster<scalar_t> cluster {};
 
-			if (data[pos] <= threshold)
-				continue;
+	visited.next();
+	stack.clear();
 
-			bool max = true;
-			const f32 value = data[pos];
-
-			const bool can_up = y > 0;
-			const bool can_down = y < size.y - 1;
+	/*
+	 * A depth first flood fill with an explicit stack. Neighbours are pushed in reverse,
+	 * and only checked when they are taken from the stack, so pixels are visited in the
+	 * same order as a recursive fill would, without its unbounded recursion depth.
+	 */
+	stack.push_back(ClusterSeed {center, std::numeric_limits<f32>::max()});
 
-			const bool can_left = x > 0;
-			const bool can_right = x < size.x - 1;
+	while (!stack.empty()) {
+		const ClusterSeed seed = stack.back();
+		stack.pop_back();
 
-			if (can_left)
-				max &= data[{x - 1, y + 0}] < value;
+		const index2_t position = seed.position;
 
-			if (can_right)
-				max &= data[{x + 1, y + 0}] <= value;
+		if (position.x < 0 || position.x >= size.x)
+			continue;
 
-			if (can_up) {
-				max &= data[{x + 0, y - 1}] < value;
+		if (position.y < 0 || position.y >= size.y)
+			continue;
 
-				if (can_left)
-					max &= data[{x - 1, y - 1}] < value;
+		const f32 value = data[position];
 
-				if (can_right)
-					max &= data[{x + 1, y - 1}] < value;
-			}
+		if (value <= dthresh)
+			continue;
 
-			if (can_down) {
-				max &= data[{x + 0, y + 1}] <= value;
+		// Once we left the activation area, don't allow the value to increase again
+		if (seed.previous <= athresh && value > seed.previous)
+			continue;
 
-				if (can_left)
-					max &= data[{x - 1, y + 1}] <= value;
+		if (visited.contains(position))
+			continue;
 
-				if (can_right)
-					max &= data[{x + 1, y + 1}] <= value;
-			}
+		cluster.add(position, value);
+		visited.visit(position);
 
-			if (max)
-				out.push_back(pos);
-		}
+		stack.push_back(ClusterSeed {position + index2_t {0, -1}, value});
+		stack.push_back(ClusterSeed {position + index2_t {-1, 0}, value});
+		stack.push_back(ClusterSeed {position + index2_t {0, 1}, value});
+		stack.push_back(ClusterSeed {position + index2_t {1, 0}, value});
 	}
+
+	return cluster;
 }
 
-static void span_cluster_recursive(const container::Image<f32> &data, Cluster &cluster,
-				   const f32 athresh, const f32 dthresh, const index2_t position,
-				   const f32 previous)
+LabelState::LabelState(index2_t size) : forest {size}
 {
-	const index2_t size = data.size();
+	// The forest is indexed with u16
+	if (size.span() > std::numeric_limits<u16>::max())
+		throw std::runtime_error("Heatmap is too large for labeling!");
 
-	if (position.x < 0 || position.x >= size.x)
-		return;
+	this->sums.resize(gsl::narrow<std::size_t>(size.span()));
+	this->peaks.resize(gsl::narrow<std::size_t>(size.span()));
+}
 
-	if (position.y < 0 || position.y >= size.y)
-		return;
+static void label_merge(LabelState &state, u16 &root, u16 neighbour)
+{
+	namespace impl = advanced::alg::impl;
 
-	const f32 value = data[position];
+	const u16 other = impl::find_root(state.forest, neighbour);
 
-	if (value <= dthresh)
+	if (other == root)
 		return;
 
-	// Once we left the activation area, don't allow the value to increase again
-	if (previous <= athresh && value > previous)
-		return;
+	// Like label(), the smaller index always becomes the new root
+	const u16 keep = std::min(root, other);
+	const u16 drop = std::max(root, other);
 
-	if (cluster.contains(position))
-		return;
+	impl::set_root(state.forest, neighbour, keep);
+	impl::set_root(state.forest, root, keep);
 
-	cluster.add(position, value);
+	state.sums[keep].merge(state.sums[drop]);
+	state.peaks[keep] = std::max(state.peaks[keep], state.peaks[drop]);
 
-	span_cluster_recursive(data, cluster, athresh, dthresh, position + index2_t {1, 0}, value);
-	span_cluster_recursive(data, cluster, athresh, dthresh, position + index2_t {0, 1}, value);
-	span_cluster_recursive(data, cluster, athresh, dthresh, position + index2_t {-1, 0}, value);
-	span_cluster_recursive(data, cluster, athresh, dthresh, position + index2_t {0, -1}, value);
+	root = keep;
 }
 
-Cluster span_cluster(const container::Image<f32> &data, const f32 athresh, const f32 dthresh,
-		     const index2_t center)
+void label_clusters(const container::Image<f32> &data, const f32 athresh, const f32 dthresh,
+		    const Region &region, LabelState &state, std::vector<Cluster<scalar_t>> &out)
 {
-	Cluster cluster {data.size()};
+	const index2_t size = data.size();
 
-	span_cluster_recursive(data, cluster, athresh, dthresh, center,
-			       std::numeric_limits<f32>::max());
+	for (index_t y = region.min.y; y < region.max.y; y++) {
+		for (index_t x = region.min.x; x < region.max.x; x++) {
+			const index_t i = y * size.x + x;
+			const f32 value = data[i];
 
-	return cluster;
+			if (value <= dthresh)
+				continue;
+
+			// Start a new tree, and merge it with the regions to the left and above
+			u16 root = gsl::narrow_cast<u16>(i);
+
+			state.forest[i] = root;
+			state.sums[i] = Cluster<scalar_t> {};
+			state.sums[i].add(index2_t {x, y}, value);
+			state.peaks[i] = value;
+
+			if (x > region.min.x && data[i - 1] > dthresh)
+				label_merge(state, root, gsl::narrow_cast<u16>(i - 1));
+
+			if (y > region.min.y && data[i - size.x] > dthresh)
+				label_merge(state, root, gsl::narrow_cast<u16>(i - size.x));
+		}
+	}
+
+	for (index_t y = region.min.y; y < region.max.y; y++) {
+		for (index_t x = region.min.x; x < region.max.x; x++) {
+			const index_t i = y * size.x + x;
+
+			if (data[i] <= dthresh || state.forest[i] != i)
+				continue;
+
+			// Hysteresis: The region must have been activated somewhere
+			if (state.peaks[i] <= athresh)
+				continue;
+
+			out.push_back(state.sums[i]);
+		}
+	}
 }
 
 } // namespace iptsd::contacts::basic::algorithms
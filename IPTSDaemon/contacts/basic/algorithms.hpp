@@ -3,6 +3,8 @@
 #ifndef IPTSD_CONTACTS_BASIC_ALGORITHMS_HPP
 #define IPTSD_CONTACTS_BASIC_ALGORITHMS_HPP
 
+#include "../interface.hpp"
+#include "../region.hpp"
 #include "cluster.hpp"
 
 #include <common/types.hpp>
@@ -12,11 +14,43 @@
 
 namespace iptsd::contacts::basic::algorithms {
 
-void find_local_maximas(const container::Image<f32> &data, const f32 threshold,
-			std::vector<index2_t> &out);
-
-Cluster span_cluster(const container::Image<f32> &data, const f32 athresh, const f32 dthresh,
-		     const index2_t center);
+struct ClusterSeed {
+	index2_t position;
+	f32 previous;
+};
+
+/*
+ * Grows a cluster around center. visited and stack are scratch space that is reused
+ * between calls, so that growing a cluster doesn't allocate memory.
+ */
+Cluster<scalar_t> span_cluster(const container::Image<f32> &data, const f32 athresh,
+			       const f32 dthresh, const index2_t center, VisitedMap &visited,
+			       std::vector<ClusterSeed> &stack);
+
+/*
+ * Scratch space for label_clusters, sized for one heatmap.
+ */
+class LabelState {
+public:
+	// Union-find forest over the pixels, the sums and peaks are only valid for roots.
+	container::Image<u16> forest;
+	std::vector<Cluster<scalar_t>> sums;
+	std::vector<f32> peaks;
+
+public:
+	LabelState(index2_t size);
+};
+
+/*
+ * Finds all clusters in one pass over the heatmap, by labeling connected regions
+ * above dthresh and adding up their moments on the way. Regions that never reach
+ * athresh are ignored. Unlike span_cluster, which grows one cluster per local maximum,
+ * contacts that touch each other end up in the same cluster.
+ *
+ * Only the given region is labeled, values outside of it should not be above dthresh.
+ */
+void label_clusters(const container::Image<f32> &data, const f32 athresh, const f32 dthresh,
+		    const Region &region, LabelState &state, std::vector<Cluster<scalar_t>> &out);
 
 } /* namespace iptsd::contacts::basic::algorithms */
 
@@ -4,44 +4,25 @@
 
 #include <common/types.hpp>
 
+#include <algorithm>
 #include <gsl/gsl>
 
 namespace iptsd::contacts::basic {
 
-Cluster::Cluster(index2_t size) : visited {size}
+VisitedMap::VisitedMap(index2_t size) : visited {size}
 {
-	std::fill(this->visited.begin(), this->visited.end(), false);
+	std::fill(this->visited.begin(), this->visited.end(), 0);
 }
 
-math::Vec2<f64> Cluster::mean() const
+void VisitedMap::next()
 {
-	return math::Vec2<f64> {this->x / this->w, this->y / this->w};
-}
-
-math::Mat2s<f64> Cluster::cov() const
-{
-	const f64 r1 = (this->xx - (this->x * this->x / this->w)) / this->w;
-	const f64 r2 = (this->yy - (this->y * this->y / this->w)) / this->w;
-	const f64 r3 = (this->xy - (this->x * this->y / this->w)) / this->w;
-
-	return math::Mat2s<f64> {r1, r3, r2};
-}
+	this->generation++;
 
-void Cluster::add(index2_t position, f64 value)
-{
-	this->x += value * position.x;
-	this->y += value * position.y;
-	this->xx += value * position.x * position.x;
-	this->yy += value * position.y * position.y;
-	this->xy += value * position.x * position.y;
-	this->w += value;
-
-	this->visited[position] = true;
-}
-
-bool Cluster::contains(index2_t position)
-{
-	return this->visited[position];
+	// After a wraparound, old marks could look like they belong to the current generation
+	if (this->generation == 0) {
+		std::fill(this->visited.begin(), this->visited.end(), 0);
+		this->generation = 1;
+	}
 }
 
 } // namespace iptsd::contacts::basic
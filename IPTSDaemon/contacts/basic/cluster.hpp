@@ -12,28 +12,115 @@
 
 namespace iptsd::contacts::basic {
 
-class Cluster {
+/*
+ * The weighted moments of a cluster, from which its mean and covariance are computed.
+ *
+ * The moments are taken relative to the first pixel that was added. With absolute positions,
+ * the second moments grow with the square of the distance to the corner of the heatmap, and
+ * in single precision the covariance loses most of its digits when the mean is subtracted.
+ */
+template <class T> class Cluster {
 public:
-	f64 x = 0;
-	f64 y = 0;
-	f64 xx = 0;
-	f64 yy = 0;
-	f64 xy = 0;
-	f64 w = 0;
+	index2_t origin {0, 0};
 
+	T x = 0;
+	T y = 0;
+	T xx = 0;
+	T yy = 0;
+	T xy = 0;
+	T w = 0;
+
+public:
+	[[nodiscard]] math::Vec2<T> mean() const;
+	[[nodiscard]] math::Mat2s<T> cov() const;
+
+	void add(index2_t position, T value);
+	void merge(const Cluster<T> &other);
+};
+
+/*
+ * Remembers which pixels were already added to a cluster.
+ *
+ * Instead of clearing the map for every cluster, each cluster gets a new generation,
+ * and only pixels that are marked with the current generation count as visited.
+ */
+class VisitedMap {
 private:
-	container::Image<bool> visited;
+	container::Image<u32> visited;
+	u32 generation = 0;
 
 public:
-	Cluster(index2_t size);
+	VisitedMap(index2_t size);
 
-	[[nodiscard]] math::Vec2<f64> mean() const;
-	[[nodiscard]] math::Mat2s<f64> cov() const;
+	// Forgets all visited pixels.
+	void next();
 
-	void add(index2_t position, f64 value);
-	bool contains(index2_t position);
+	void visit(index2_t position);
+	[[nodiscard]] bool contains(index2_t position) const;
 };
 
+template <class T> inline math::Vec2<T> Cluster<T>::mean() const
+{
+	const T ox = static_cast<T>(this->origin.x);
+	const T oy = static_cast<T>(this->origin.y);
+
+	return math::Vec2<T> {ox + this->x / this->w, oy + this->y / this->w};
+}
+
+template <class T> inline math::Mat2s<T> Cluster<T>::cov() const
+{
+	const T r1 = (this->xx - (this->x * this->x / this->w)) / this->w;
+	const T r2 = (this->yy - (this->y * this->y / this->w)) / this->w;
+	const T r3 = (this->xy - (this->x * this->y / this->w)) / this->w;
+
+	return math::Mat2s<T> {r1, r3, r2};
+}
+
+template <class T> inline void Cluster<T>::add(index2_t position, T value)
+{
+	if (this->w == 0)
+		this->origin = position;
+
+	const T px = static_cast<T>(position.x - this->origin.x);
+	const T py = static_cast<T>(position.y - this->origin.y);
+
+	this->x += value * px;
+	this->y += value * py;
+	this->xx += value * px * px;
+	this->yy += value * py * py;
+	this->xy += value * px * py;
+	this->w += value;
+}
+
+template <class T> inline void Cluster<T>::merge(const Cluster<T> &other)
+{
+	if (this->w == 0) {
+		*this = other;
+		return;
+	}
+
+	// Move the moments of other to our origin
+	const T dx = static_cast<T>(other.origin.x - this->origin.x);
+	const T dy = static_cast<T>(other.origin.y - this->origin.y);
+
+	this->xx += other.xx + 2 * dx * other.x + dx * dx * other.w;
+	this->yy += other.yy + 2 * dy * other.y + dy * dy * other.w;
+	this->xy += other.xy + dx * other.y + dy * other.x + dx * dy * other.w;
+	this->x += other.x + dx * other.w;
+	this->y += other.y + dy * other.w;
+	this->w += other.w;
+}
+
+inline void VisitedMap::visit(index2_t position)
+{
+	this->visited[position] = this->generation;
+}
+
+inline bool VisitedMap::contains(index2_t position) const
+{
+	return this->visited[position] == this->generation;
+}
+
 } /* namespace iptsd::contacts::basic */
 
 #endif /* IPTSD_CONTACTS_BASIC_CLUSTER_HPP */
@@ -3,7 +3,6 @@
 #include "detector.hpp"
 
 #include "../interface.hpp"
-#include "../neutral.hpp"
 #include "algorithms.hpp"
 #include "cluster.hpp"
 
@@ -25,31 +24,51 @@ const std::vector<Blob> &BlobDetector::search()
 	this->maximas.clear();
 	this->blobs.clear();
 
-	const f32 nval = neutral(this->config, this->heatmap);
-	const f32 athresh = nval + (this->config.activation_threshold / 255);
-	const f32 dthresh = nval + (this->config.deactivation_threshold / 255);
+	const f32 athresh = this->neutral + (this->config.activation_threshold / 255);
+	const f32 dthresh = this->neutral + (this->config.deactivation_threshold / 255);
 
-	// Search for local maxima
-	algorithms::find_local_maximas(this->heatmap, athresh, this->maximas);
+	if (this->config.single_pass) {
+		this->clusters.clear();
+		algorithms::label_clusters(this->heatmap, athresh, dthresh, this->region,
+					   this->labels, this->clusters);
 
-	// Iterate over the maximas and start building clusters
-	for (const index2_t point : this->maximas) {
-		const Cluster cluster = algorithms::span_cluster(this->heatmap, athresh, dthresh, point);
+		for (const Cluster<scalar_t> &cluster : this->clusters)
+			this->add_blob(cluster);
+
+		return this->blobs;
+	}
 
-		const math::Mat2s<f64> cov = cluster.cov();
-		const math::Eigen2<f64> eigen = cov.eigen();
+	// Search for local maxima
+	// Nothing outside of the region is above the threshold, so clusters can't
+	// leave it either, and only the local maxima search needs to be limited.
+	this->maxima.find(this->heatmap, athresh, this->region, this->maximas);
 
-		if (eigen.w[0] <= 0 || eigen.w[1] <= 0)
-			continue;
+	// Iterate over the maximas and start building clusters
+	for (const index_t i : this->maximas) {
+		const index2_t point = container::Image<f32>::unravel(this->heatmap.size(), i);
 
-		if (std::isnan(eigen.v[0].x) || std::isnan(eigen.v[0].y) ||
-		    std::isnan(eigen.v[1].x) || std::isnan(eigen.v[1].x))
-			continue;
+		const Cluster<scalar_t> cluster = algorithms::span_cluster(
+			this->heatmap, athresh, dthresh, point, this->visited, this->stack);
 
-		this->blobs.push_back(Blob {cluster.mean() + 0.5, cov});
+		this->add_blob(cluster);
 	}
 
 	return this->blobs;
 }
 
+void BlobDetector::add_blob(const Cluster<scalar_t> &cluster)
+{
+	const math::Mat2s<scalar_t> cov = cluster.cov();
+	const math::Eigen2<scalar_t> eigen = cov.eigen();
+
+	if (eigen.w[0] <= 0 || eigen.w[1] <= 0)
+		return;
+
+	if (std::isnan(eigen.v[0].x) || std::isnan(eigen.v[0].y) ||
+	    std::isnan(eigen.v[1].x) || std::isnan(eigen.v[1].x))
+		return;
+
+	this->blobs.push_back(Blob {cluster.mean() + static_cast<scalar_t>(0.5), cov});
+}
+
 } // namespace iptsd::contacts::basic
@@ -4,10 +4,16 @@
 #define IPTSD_CONTACTS_BASIC_DETECTOR_HPP
 
 #include "../interface.hpp"
+#include "../maxima.hpp"
+#include "algorithms.hpp"
+#include "cluster.hpp"
 
 #include <common/types.hpp>
 #include <container/image.hpp>
 
+#include <algorithm>
+#include <cstddef>
+#include <gsl/gsl>
 #include <vector>
 
 namespace iptsd::contacts::basic {
@@ -17,16 +23,38 @@ private:
 	BlobDetectorConfig config;
 
 	container::Image<f32> heatmap;
+	f32 neutral = 0;
+	Region region;
 
-	std::vector<index2_t> maximas;
+	LocalMaxima maxima;
+	std::vector<index_t> maximas;
 	std::vector<Blob> blobs;
 
+	VisitedMap visited;
+	std::vector<algorithms::ClusterSeed> stack;
+
+	algorithms::LabelState labels;
+	std::vector<Cluster<scalar_t>> clusters;
+
 public:
 	BlobDetector(const index2_t size, const BlobDetectorConfig config)
-		: config {config}, heatmap {size}, maximas {64}, blobs {64} {};
+		: config {config}, heatmap {size}, region {index2_t {0, 0}, size}, maximas {64},
+		  blobs {64}, visited {size}, labels {size}
+	{
+		this->clusters.reserve(64);
+
+		// Every pixel is visited at most once and pushes 4 neighbours
+		this->stack.reserve(gsl::narrow<std::size_t>(size.span()) * 4 + 1);
+	};
 
 	container::Image<f32> &data() override;
 	const std::vector<Blob> &search() override;
+	void set_neutral(f32 value) override;
+	[[nodiscard]] f32 threshold() const override;
+	void set_region(const Region &region) override;
+
+private:
+	void add_blob(const Cluster<scalar_t> &cluster);
 };
 
 inline container::Image<f32> &BlobDetector::data()
@@ -34,6 +62,26 @@ inline container::Image<f32> &BlobDetector::data()
 	return this->heatmap;
 }
 
+inline void BlobDetector::set_neutral(f32 value)
+{
+	this->neutral = value;
+}
+
+inline f32 BlobDetector::threshold() const
+{
+	// Clusters grow down to the deactivation threshold, so for the region
+	// to contain all of them, this has to be the lower of both.
+	const f32 thresh =
+		std::min(this->config.activation_threshold, this->config.deactivation_threshold);
+
+	return this->neutral + (thresh / 255);
+}
+
+inline void BlobDetector::set_region(const Region &region)
+{
+	this->region = region;
+}
+
 } /* namespace iptsd::contacts::basic */
 
 #endif /* IPTSD_CONTACTS_BASIC_DETECTOR_HPP */
@@ -10,38 +10,51 @@
 #include <math/mat2.hpp>
 
 #include <algorithm>
+#include <bitset>
 #include <cmath>
 #include <gsl/gsl>
 #include <memory>
+#include <spdlog/spdlog.h>
 #include <stdexcept>
 #include <vector>
 
 namespace iptsd::contacts {
 
-ContactFinder::ContactFinder(Config config)
-	: config {config}, phys_diag(std::hypot(config.width, config.height))
+// Longer gaps between two heatmaps are treated as a new start for all predictors.
+static constexpr f64 MAX_INTERVAL = 0.1;
+
+// How long the timestamps are compared with the host clock for one measurement of their rate.
+static constexpr f64 RATE_WINDOW = 2;
+
+template <class T>
+BasicContactFinder<T>::BasicContactFinder(Config config)
+	: config {config}, neutral {config.neutral_mode, config.neutral_value},
+	  phys_diag(std::hypot(config.width, config.height))
 {
-	this->distances.resize(static_cast<std::size_t>(config.max_contacts) * config.max_contacts);
+	// Contacts are matched on fixed size storage, and their indices are tracked in a u16
+	if (config.max_contacts > IPTS_MAX_CONTACTS)
+		throw std::runtime_error("Too many contacts!");
 
 	// The temporal window must at least be 2 for finger tracking to work
 	if (config.temporal_window < 2)
 		throw std::runtime_error("The temporal window must at least be two!");
 
-	for (std::size_t i = 0; i < config.temporal_window; i++) {
-		std::vector<Contact> frame(config.max_contacts);
+	if (config.temporal_window > max_window)
+		throw std::runtime_error("The temporal window is too large!");
 
+	this->predictors.fill(Predictor<T> {config.prediction_alpha, config.prediction_beta});
+
+	for (Frame &frame : this->frames) {
 		// Make sure that the contacts in last have proper indices set,
 		// to avoid copying the index 0 to all contacts.
 		for (u32 j = 0; j < frame.size(); j++) {
 			frame[j].index = j;
 			frame[j].active = false;
 		}
-
-		this->frames.push_back(std::move(frame));
 	}
 }
 
-void ContactFinder::resize(index2_t size)
+template <class T> void BasicContactFinder<T>::resize(index2_t size)
 {
 	if (this->detector && this->size == size)
 		return;
@@ -49,6 +62,7 @@ void ContactFinder::resize(index2_t size)
 	this->detector.reset();
 	this->size = size;
 	this->data_diag = std::hypot(size.x, size.y);
+	this->tiles = TileMap {size};
 
 	BlobDetectorConfig config {};
 	config.neutral_mode = this->config.neutral_mode;
@@ -56,26 +70,106 @@ void ContactFinder::resize(index2_t size)
 	config.activation_threshold = this->config.activation_threshold;
 	config.deactivation_threshold = this->config.deactivation_threshold;
 
-	if (this->config.detection_mode == BlobDetection::BASIC)
+	config.single_pass = this->config.detection_mode == BlobDetection::LABEL;
+
+	if (this->config.detection_mode == BlobDetection::BASIC ||
+	    this->config.detection_mode == BlobDetection::LABEL)
 		this->detector = std::make_unique<basic::BlobDetector>(size, config);
 	else if (this->config.detection_mode == BlobDetection::ADVANCED)
 		this->detector = std::make_unique<advanced::BlobDetector>(size, config);
+
+	this->detector->set_neutral(this->neutral.value());
+}
+
+template <class T> void BasicContactFinder<T>::load(gsl::span<const u8> heatmap, u8 min, u8 max, u32 timestamp)
+{
+	const auto now = std::chrono::steady_clock::now();
+
+	// The timestamp can wrap around, the unsigned difference is still correct.
+	const u32 ticks = timestamp - this->timestamp;
+
+	if (ticks != 0) {
+		this->measure_rate(ticks, std::chrono::duration<f64>(now - this->loaded).count());
+		this->interval = static_cast<T>(static_cast<f64>(ticks) / this->rate);
+	} else {
+		// The device sent no timestamp (it stays 0) or the same one again. Without a
+		// fallback, the interval would always be 0 and prediction would do nothing.
+		if (!this->host_clock && this->config.prediction_latency > 0)
+			spdlog::info("Heatmap timestamps don't advance, predicting with the host clock");
+
+		this->host_clock = true;
+		this->interval = static_cast<T>(
+			std::chrono::duration<f64>(now - this->loaded).count());
+	}
+
+	this->timestamp = timestamp;
+	this->loaded = now;
+
+	if (this->interval > MAX_INTERVAL)
+		this->interval = 0;
+
+	this->normalizer.update(min, max);
+	this->normalizer.apply(heatmap, this->data(), this->heatmap_stats);
+
+	if (this->neutral.update(this->heatmap_stats))
+		this->detector->set_neutral(this->neutral.value());
+}
+
+/*
+ * The host clock is only exact over longer periods, since every heatmap is delayed by a
+ * different amount until it is loaded. So the ticks and host time between heatmaps are summed
+ * up, and the rate is updated once enough time has passed.
+ *
+ * A replay that runs faster or slower than real time would measure the wrong rate. Rates that
+ * are far away from the nominal one are therefore ignored.
+ */
+template <class T> void BasicContactFinder<T>::measure_rate(u32 ticks, f64 seconds)
+{
+	// After a gap, or for the first heatmap, the host time doesn't belong to these ticks
+	if (seconds <= 0 || seconds > MAX_INTERVAL)
+		return;
+
+	this->rate_ticks += ticks;
+	this->rate_seconds += seconds;
+
+	if (this->rate_seconds < RATE_WINDOW)
+		return;
+
+	const f64 measured = static_cast<f64>(this->rate_ticks) / this->rate_seconds;
+
+	this->rate_ticks = 0;
+	this->rate_seconds = 0;
+
+	if (measured < ticks_per_second / 4 || measured > ticks_per_second * 4)
+		return;
+
+	if (!this->rate_measured)
+		spdlog::info("Heatmap timestamps count at {:.3f}MHz", measured / 1e6);
+
+	this->rate = measured;
+	this->rate_measured = true;
 }
 
-void ContactFinder::reset()
+template <class T> f64 BasicContactFinder<T>::tick_rate() const
 {
-	for (std::size_t i = 0; i < config.temporal_window; i++) {
-		const std::size_t size = this->frames[i].size();
+	return this->rate;
+}
 
-		for (std::size_t j = 0; j < size; j++)
-			this->frames[i][j].active = false;
+template <class T> void BasicContactFinder<T>::reset()
+{
+	for (Frame &frame : this->frames) {
+		for (Contact &contact : frame)
+			contact.active = false;
 	}
+
+	for (Predictor<T> &predictor : this->predictors)
+		predictor.reset();
 }
 
-bool ContactFinder::check_valid(const Contact &contact)
+template <class T> bool BasicContactFinder<T>::check_valid(const Contact &contact)
 {
-	const f64 aspect = contact.major / contact.minor;
-	const f64 major = contact.major * this->phys_diag;
+	const T aspect = contact.major / contact.minor;
+	const T major = contact.major * this->phys_diag;
 
 	if (aspect < this->config.aspect_min || aspect > this->config.aspect_max)
 		return false;
@@ -86,24 +180,43 @@ bool ContactFinder::check_valid(const Contact &contact)
 	return true;
 }
 
-bool ContactFinder::check_dist(const Contact &from, const Contact &to)
+template <class T> bool BasicContactFinder<T>::check_dist(const Contact &from, const Contact &to)
 {
 	// Assumption: All contacts are perfect circles. The radius is major / 2.
 	// This might cover a bit more area than neccessary, but will make implementation easier.
 
-	const f64 dx = (from.x - to.x) * this->config.width;
-	const f64 dy = (from.y - to.y) * this->config.height;
+	const T dx = (from.x - to.x) * this->config.width;
+	const T dy = (from.y - to.y) * this->config.height;
 
-	f64 dist = std::hypot(dx, dy);
+	T dist = std::hypot(dx, dy);
 	dist -= (from.major * this->phys_diag) / 2;
 	dist -= (to.major * this->phys_diag) / 2;
 
 	return dist <= this->config.dist_thresh;
 }
 
-const std::vector<Contact> &ContactFinder::search()
+template <class T> gsl::span<const BasicContact<T>> BasicContactFinder<T>::search()
 {
-	const std::vector<Blob> &blobs = this->detector->search();
+	Frame &current = this->frame(0);
+
+	// Most frames contain no touch at all. The largest value is already known from
+	// normalization, so the detector doesn't need to run to find out that it is empty.
+	// The rest of the search still runs, to lift contacts and advance the frame history.
+	const f32 threshold = this->detector->threshold();
+	const bool idle = this->heatmap_stats.max <= threshold;
+
+	this->idle.frames++;
+
+	// Otherwise, only the touched part of the heatmap has to be searched.
+	if (idle) {
+		this->idle.skipped++;
+		this->tiles.clear();
+	} else {
+		this->tiles.update(this->data(), threshold);
+		this->detector->set_region(this->tiles.region());
+	}
+
+	const std::vector<Blob> &blobs = idle ? this->no_blobs : this->detector->search();
     const u32 count = std::min(gsl::narrow_cast<u32>(blobs.size()), this->config.max_contacts);
     
     u32 actual_cnt = count;
@@ -111,10 +224,10 @@ const std::vector<Contact> &ContactFinder::search()
 
 	for (u32 i = 0; i < actual_cnt; i++) {
 		const Blob &blob = blobs[i+palm_cnt];
-		Contact &contact = this->frames[0][i];
+		Contact &contact = current[i];
 
-		contact.x = blob.mean.x / gsl::narrow<f32>(this->size.x);
-		contact.y = blob.mean.y / gsl::narrow<f32>(this->size.y);
+		contact.x = static_cast<T>(blob.mean.x) / gsl::narrow<T>(this->size.x);
+		contact.y = static_cast<T>(blob.mean.y) / gsl::narrow<T>(this->size.y);
 
 		if (this->config.invert_x)
 			contact.x = 1 - contact.x;
@@ -122,12 +235,12 @@ const std::vector<Contact> &ContactFinder::search()
 		if (this->config.invert_y)
 			contact.y = 1 - contact.y;
 
-		const math::Eigen2<f64> eigen = blob.cov.eigen();
-		const f64 s1 = std::sqrt(eigen.w[0]);
-		const f64 s2 = std::sqrt(eigen.w[1]);
+		const math::Eigen2<T> eigen = blob.cov.template cast<T>().eigen();
+		const T s1 = std::sqrt(eigen.w[0]);
+		const T s2 = std::sqrt(eigen.w[1]);
 
-		const f64 d1 = s1 / this->data_diag;
-		const f64 d2 = s2 / this->data_diag;
+		const T d1 = s1 / this->data_diag;
+		const T d2 = s2 / this->data_diag;
 
 		contact.major = std::max(d1, d2);
 		contact.minor = std::min(d1, d2);
@@ -137,18 +250,18 @@ const std::vector<Contact> &ContactFinder::search()
 		contact.major *= 2;
 		contact.minor *= 2;
 
-		const math::Vec2<f64> v = eigen.v[0].cast<f64>() * s1;
-		f64 angle = std::atan2(v.x, v.y) + (math::num<f64>::pi / 2);
+		const math::Vec2<T> v = eigen.v[0] * s1;
+		T angle = std::atan2(v.x, v.y) + (math::num<T>::pi / 2);
 
 		// It is not possible to say if the contact faces up or down,
 		// so we make sure the angle is between 0° and 180° to be consistent
 		if (angle < 0)
-			angle += math::num<f64>::pi;
-		else if (angle >= math::num<f64>::pi)
-			angle -= math::num<f64>::pi;
+			angle += math::num<T>::pi;
+		else if (angle >= math::num<T>::pi)
+			angle -= math::num<T>::pi;
 
 		if (this->config.invert_x != this->config.invert_y)
-			angle = math::num<f64>::pi - angle;
+			angle = math::num<T>::pi - angle;
 
 		contact.angle = angle;
         
@@ -162,31 +275,20 @@ const std::vector<Contact> &ContactFinder::search()
         if (!contact.valid) {   // put invalid touch (palm) to the end
             i--;
             palm_cnt++;
-            std::swap(contact, this->frames[0][--actual_cnt]);
+            std::swap(contact, current[--actual_cnt]);
         }
 	}
 
 	for (u32 i = count; i < this->config.max_contacts; i++) {
-        Contact &contact = this->frames[0][i];
-
-		contact.index = i;
-		contact.active = false;
-		contact.valid = true;
-		contact.x = 0;
-		contact.y = 0;
-		contact.angle = 0;
-		contact.major = 0;
-		contact.minor = 0;
-        
-        contact.instability = 0;
-        contact.tracked = false;
+		current[i] = Contact {};
+		current[i].index = i;
 	}
 
 	// Mark contacts that are very close to an invalid contact as unstable
     for (u32 i = actual_cnt; i < count; i++) {
-        const Contact &contact = this->frames[0][i];
+        const Contact &contact = current[i];
         for (u32 j = 0; j < actual_cnt; j++) {
-            Contact &other = this->frames[0][j];
+            Contact &other = current[j];
 			if (!this->check_dist(contact, other))
 				continue;
 
@@ -198,54 +300,105 @@ const std::vector<Contact> &ContactFinder::search()
         this->track(actual_cnt);
     touching = actual_cnt > 0;
 
-    for (std::size_t i = config.temporal_window - 1; i > 0; i--)
-        std::swap(this->frames[i], this->frames[i - 1]);
+    // The oldest frame will be overwritten by the next search
+    this->head = (this->head + 1) % this->config.temporal_window;
     last_touch_cnt = actual_cnt;
 
-	return this->frames[1];
+	if (this->config.prediction_latency > 0)
+		return this->predict(current);
+
+	return gsl::span<const Contact> {current.data(), this->config.max_contacts};
+}
+
+template <class T>
+gsl::span<const BasicContact<T>> BasicContactFinder<T>::predict(const Frame &current)
+{
+	// Tracking has to continue from the measured positions, so the predicted ones are a copy.
+	const T latency = this->config.prediction_latency / 1000;
+	std::bitset<IPTS_MAX_CONTACTS> seen {};
+
+	for (u32 i = 0; i < this->config.max_contacts; i++) {
+		const Contact &contact = current[i];
+		Contact &out = this->predicted[i];
+
+		out = contact;
+
+		if (!contact.active || !contact.valid)
+			continue;
+
+		Predictor<T> &predictor = this->predictors[contact.index];
+
+		// A contact that was not matched with one from the last frame is a new finger
+		if (!contact.tracked)
+			predictor.reset();
+
+		predictor.update(math::Vec2<T> {contact.x, contact.y}, this->interval);
+		seen.set(contact.index);
+
+		const math::Vec2<T> position = predictor.predict(latency);
+
+		out.x = std::clamp<T>(position.x, 0, 1);
+		out.y = std::clamp<T>(position.y, 0, 1);
+	}
+
+	// Lifted contacts start over when their index is used again
+	for (std::size_t i = 0; i < this->predictors.size(); i++) {
+		if (!seen.test(i))
+			this->predictors[i].reset();
+	}
+
+	return gsl::span<const Contact> {this->predicted.data(), this->config.max_contacts};
 }
 
-void ContactFinder::track(u32 &touch_cnt)
+template <class T> void BasicContactFinder<T>::track(u32 &touch_cnt)
 {
+	Frame &current = this->frame(0);
+	Frame &previous = this->frame(1);
+
     // Delete last instable touch inputs
     for (u32 j = 0; j < this->last_touch_cnt; j++) {
-        if (this->frames[1][j].instability >= this->config.instability_tolerance) {
+        if (previous[j].instability >= this->config.instability_tolerance) {
             if (j != this->last_touch_cnt-1) {
-                std::swap(this->frames[1][j], this->frames[1][this->last_touch_cnt-1]);
+                std::swap(previous[j], previous[this->last_touch_cnt-1]);
                 j--;
             }
             this->last_touch_cnt--;
         }
     }
-	// Calculate the distances between current and previous valid inputs
+	// Match the current inputs with the previous ones, so that the sum of the squared
+	// distances between them is as small as possible. Always picking the closest pair
+	// instead can swap the indices of fingers that move past each other.
+	//
+	// This only looks at positions, so indices can still swap if fingers move further
+	// between two frames than they are apart, or if they merge into one blob while passing
+	// each other. Once they separate again, nothing tells which finger is which. See the
+	// crossing test of IPTSPerf: on a 64x44 heatmap, fingers that pass each other at 3cm
+	// keep their indices, at 2cm and less they can merge and swap.
+	this->assignment.resize(touch_cnt, this->last_touch_cnt);
+
 	for (u32 i = 0; i < touch_cnt; i++) {
 		for (u32 j = 0; j < this->last_touch_cnt; j++) {
-			const Contact &in = this->frames[0][i];
-			const Contact &last = this->frames[1][j];
-            
-            const f64 dx = in.x - last.x;
-            const f64 dy = in.y - last.y;
-
-            u32 idx = i * this->last_touch_cnt + j;
-			this->distances[idx] = std::hypot(dx, dy);
+			const Contact &in = current[i];
+			const Contact &last = previous[j];
+
+			const T dx = in.x - last.x;
+			const T dy = in.y - last.y;
+
+			this->assignment.cost(i, j) = dx * dx + dy * dy;
 		}
 	}
 
-	// Select the smallest calculated distance to find the closest two inputs.
-	// Copy the index from the previous to the current input. Then invalidate
-	// all distance entries that contain the two inputs, and repeat until we
-	// found an index for all inputs.
-    u32 count = std::min(touch_cnt, this->last_touch_cnt);
-    u16 idx_used = 0;
-	for (u32 k = 0; k < count; k++) {
-		auto it = std::min_element(this->distances.begin(), this->distances.begin() + touch_cnt*last_touch_cnt);
-		u32 idx = (u32)std::distance(this->distances.begin(), it);
+	this->assignment.solve();
 
-		u32 i = idx / this->last_touch_cnt;
-		u32 j = idx % this->last_touch_cnt;
+	// Copy the index from the previous to the current input.
+	u16 idx_used = 0;
+	for (u32 i = 0; i < touch_cnt; i++) {
+		const u32 j = this->assignment.match(i);
+		if (j == Assignment<T, IPTS_MAX_CONTACTS>::none)
+			continue;
 
-		Contact &contact = this->frames[0][i];
-		const Contact &last = this->frames[1][j];
+		Contact &contact = current[i];
+		const Contact &last = previous[j];
 
         idx_used |= 1 << last.index;
         
@@ -253,16 +406,16 @@ void ContactFinder::track(u32 &touch_cnt)
         contact.instability += last.instability;
         contact.tracked = true;
 
-		const f64 dmaj = (contact.major - last.major) * this->phys_diag;
-		const f64 dmin = (contact.minor - last.minor) * this->phys_diag;
+		const T dmaj = (contact.major - last.major) * this->phys_diag;
+		const T dmin = (contact.minor - last.minor) * this->phys_diag;
 
 		// Is the contact rapidly increasing its size?
 		if (dmaj >= this->config.size_thresh || dmin >= this->config.size_thresh)
             contact.instability+=2;
 
-		const f64 dx = (contact.x - last.x) * this->config.width;
-		const f64 dy = (contact.y - last.y) * this->config.height;
-		const f64 dist = std::hypot(dx, dy);
+		const T dx = (contact.x - last.x) * this->config.width;
+		const T dy = (contact.y - last.y) * this->config.height;
+		const T dist = std::hypot(dx, dy);
 
         if (dist > this->config.position_thresh_max) {
             // Mark large position changes as unstable to prevent contacts
@@ -283,24 +436,12 @@ void ContactFinder::track(u32 &touch_cnt)
         // if current contact is stable, clear the instability counter
         if (contact.instability == last.instability)
             contact.instability = 0;
-
-		// Set the distance of all pairs that contain one of i and j
-		// to something even higher than the distance chosen above.
-		// This prevents i and j from getting selected again.
-        for (u32 x = 0; x < last_touch_cnt; x++) {
-            u32 idx1 = i * last_touch_cnt + x;
-            this->distances[idx1] = 1 << 30;
-        }
-        for (u32 x = 0; x < touch_cnt; x++) {
-            u32 idx2 = x * last_touch_cnt + j;
-            this->distances[idx2] = 1 << 30;
-        }
 	}
     
     if (touch_cnt > this->last_touch_cnt) { // some finger added
         int index = -1;
         for (u32 i = 0; i < touch_cnt; i++) {
-            auto &contact = this->frames[0][i];
+            auto &contact = current[i];
             if (!contact.tracked) {
                 while (idx_used & (1 << ++index));
                 contact.index = index;
@@ -310,13 +451,13 @@ void ContactFinder::track(u32 &touch_cnt)
         }
     } else if (touch_cnt < this->last_touch_cnt) {  // Some finger lifted
         for (u32 j = 0; j < this->last_touch_cnt; j++) {
-            if (!(idx_used & (1 << this->frames[1][j].index))) {
+            if (!(idx_used & (1 << previous[j].index))) {
                 for (u32 i = touch_cnt; i < this->config.max_contacts; i++) {
-                    if (!this->frames[0][i].active) {
+                    if (!current[i].active) {
                         if (i != touch_cnt)
-                            std::swap(this->frames[0][touch_cnt], this->frames[0][i]);
-                        this->frames[0][touch_cnt] = this->frames[1][j];
-                        this->frames[0][touch_cnt].instability++;
+                            std::swap(current[touch_cnt], current[i]);
+                        current[touch_cnt] = previous[j];
+                        current[touch_cnt].instability++;
                         touch_cnt++;
                         break;
                     }
@@ -326,4 +467,7 @@ void ContactFinder::track(u32 &touch_cnt)
     }
 }
 
+template class BasicContactFinder<f32>;
+template class BasicContactFinder<f64>;
+
 } // namespace iptsd::contacts
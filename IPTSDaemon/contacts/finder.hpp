@@ -3,24 +3,34 @@
 #ifndef IPTSD_CONTACTS_FINDER_HPP
 #define IPTSD_CONTACTS_FINDER_HPP
 
+#include "assignment.hpp"
 #include "interface.hpp"
+#include "neutral.hpp"
+#include "predictor.hpp"
+#include "region.hpp"
 
 #include <common/types.hpp>
+#include <container/ops.hpp>
+#include <ipts/protocol.hpp>
 #include <math/mat2.hpp>
 
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <gsl/gsl>
 #include <memory>
 #include <tuple>
 #include <vector>
 
 namespace iptsd::contacts {
 
-struct Contact {
-	f64 x = 0;
-	f64 y = 0;
+template <class T> struct BasicContact {
+	T x = 0;
+	T y = 0;
 
-	f64 angle = 0;
-	f64 major = 0;
-	f64 minor = 0;
+	T angle = 0;
+	T major = 0;
+	T minor = 0;
 
 	u32 index = 0;
 	bool valid = true;
@@ -29,9 +39,12 @@ struct Contact {
     bool tracked = false;
 };
 
+using Contact = BasicContact<scalar_t>;
+
 enum BlobDetection {
 	BASIC,
 	ADVANCED,
+	LABEL,
 };
 
 struct Config {
@@ -62,45 +75,144 @@ struct Config {
 	f32 dist_thresh;
     
     u8 instability_tolerance;
+
+	// How far ahead contacts are predicted, in milliseconds. 0 disables prediction.
+	f32 prediction_latency;
+	f32 prediction_alpha;
+	f32 prediction_beta;
+};
+
+/*
+ * How many frames were searched, and how many of them were skipped
+ * because no value of the heatmap was above the detection threshold.
+ */
+struct IdleStats {
+	u64 frames = 0;
+	u64 skipped = 0;
 };
 
-class ContactFinder {
+/*
+ * Finds and tracks the contacts on a heatmap. T is the type that is used for the positions
+ * and shapes of the contacts, see scalar_t.
+ */
+template <class T> class BasicContactFinder {
+public:
+	using Contact = BasicContact<T>;
+
+	// The largest temporal window that can be configured.
+	static constexpr std::size_t max_window = 16;
+
+	/*
+	 * The nominal rate of the heatmap timestamps. protocol.hpp only documents the DFT window
+	 * timestamps, which count at approximately 8MHz (see ipts_pen_dft_window). The heatmap
+	 * timestamps are assumed to come from the same clock. Since that is not documented, the
+	 * rate is measured against the host clock while heatmaps arrive, see tick_rate().
+	 * This one is only used until then.
+	 */
+	static constexpr f64 ticks_per_second = 8e6;
+
 private:
+	using Frame = std::array<Contact, IPTS_MAX_CONTACTS>;
+
 	Config config;
 
 	index2_t size {};
 	std::unique_ptr<IBlobDetector> detector = nullptr;
 
-	std::vector<std::vector<Contact>> frames {};
-	std::vector<f64> distances {};
+	container::ops::Normalizer normalizer {};
+	container::ops::NormalizeStats heatmap_stats {};
+	NeutralEstimator neutral;
+
+	IdleStats idle {};
+	const std::vector<Blob> no_blobs {};
+
+	// Tracks which parts of the heatmap are touched, see TileMap.
+	TileMap tiles {};
+
+	// One predictor per contact index, and the predicted contacts that are returned.
+	std::array<Predictor<T>, IPTS_MAX_CONTACTS> predictors {};
+	Frame predicted {};
+
+	// The device timestamp of the current heatmap, and the seconds since the last one.
+	u32 timestamp = 0;
+	T interval = 0;
+
+	// When the last heatmap was loaded, for devices whose timestamps don't advance.
+	std::chrono::steady_clock::time_point loaded {};
+	bool host_clock = false;
+
+	// The measured rate of the timestamps, and the ticks and host seconds it is measured over.
+	f64 rate = ticks_per_second;
+	u64 rate_ticks = 0;
+	f64 rate_seconds = 0;
+	bool rate_measured = false;
+
+	// The contacts of the last frames, as a ring. head is the frame that is being searched.
+	std::array<Frame, max_window> frames {};
+	std::size_t head = 0;
 
-	f64 data_diag = 0;
-	f64 phys_diag = 0;
+	Assignment<T, IPTS_MAX_CONTACTS> assignment {};
+
+	T data_diag = 0;
+	T phys_diag = 0;
     
     bool touching = false;
     u32 last_touch_cnt = 0;
 
 public:
-	ContactFinder(Config config);
+	BasicContactFinder(Config config);
 
 	container::Image<f32> &data();
-	const std::vector<Contact> &search();
+	const container::ops::NormalizeStats &stats() const;
+	const IdleStats &idle_stats() const;
+
+	// How fast the heatmap timestamps count, in ticks per second.
+	[[nodiscard]] f64 tick_rate() const;
+
+	void load(gsl::span<const u8> heatmap, u8 min, u8 max, u32 timestamp);
+	gsl::span<const Contact> search();
 
 	void resize(index2_t size);
 	void reset();
 
 private:
+	// The frame that was searched age frames ago, age 0 is the current one.
+	Frame &frame(std::size_t age);
+
 	bool check_valid(const Contact &contact);
 	bool check_dist(const Contact &from, const Contact &to);
 
+	void measure_rate(u32 ticks, f64 seconds);
 	void track(u32 &touch_cnt);
+	gsl::span<const Contact> predict(const Frame &current);
 };
 
-inline container::Image<f32> &ContactFinder::data()
+template <class T> inline container::Image<f32> &BasicContactFinder<T>::data()
 {
 	return this->detector->data();
 }
 
+template <class T>
+inline const container::ops::NormalizeStats &BasicContactFinder<T>::stats() const
+{
+	return this->heatmap_stats;
+}
+
+template <class T>
+inline typename BasicContactFinder<T>::Frame &BasicContactFinder<T>::frame(std::size_t age)
+{
+	const std::size_t window = this->config.temporal_window;
+
+	return this->frames[(this->head + window - age) % window];
+}
+
+template <class T> inline const IdleStats &BasicContactFinder<T>::idle_stats() const
+{
+	return this->idle;
+}
+
+using ContactFinder = BasicContactFinder<scalar_t>;
+
 } /* namespace iptsd::contacts */
 
 #endif /* IPTSD_CONTACTS_FINDER_HPP */
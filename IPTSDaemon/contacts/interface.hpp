@@ -3,6 +3,8 @@
 #ifndef IPTSD_CONTACTS_INTERFACE_HPP
 #define IPTSD_CONTACTS_INTERFACE_HPP
 
+#include "region.hpp"
+
 #include <common/types.hpp>
 #include <container/image.hpp>
 #include <math/mat2.hpp>
@@ -12,11 +14,23 @@
 
 namespace iptsd::contacts {
 
-struct Blob {
-	math::Vec2<f64> mean;
-	math::Mat2s<f64> cov;
+/*
+ * The scalar type that contacts are computed with, once they have been found in the heatmap.
+ * This is f64 by default, and f32 if IPTSD_CONFIG_CONTACTS_F32 is defined.
+ */
+#if defined(IPTSD_CONFIG_CONTACTS_F32)
+using scalar_t = f32;
+#else
+using scalar_t = f64;
+#endif
+
+template <class T> struct BasicBlob {
+	math::Vec2<T> mean;
+	math::Mat2s<T> cov;
 };
 
+using Blob = BasicBlob<scalar_t>;
+
 enum NeutralMode {
 	MODE,
 	AVERAGE,
@@ -29,6 +43,9 @@ struct BlobDetectorConfig {
 
 	f32 neutral_value;
 	enum NeutralMode neutral_mode;
+
+	// Basic detector only: Label all clusters in one pass, see label_clusters.
+	bool single_pass = false;
 };
 
 class IBlobDetector {
@@ -37,6 +54,16 @@ public:
 
 	virtual container::Image<f32> &data() = 0;
 	virtual const std::vector<Blob> &search() = 0;
+
+	// The neutral value is estimated outside of the detector, see NeutralEstimator.
+	virtual void set_neutral(f32 value) = 0;
+
+	// search() can only find blobs if at least one value of the heatmap is above this.
+	[[nodiscard]] virtual f32 threshold() const = 0;
+
+	// Limits search() to a part of the heatmap. Outside of it, all values must be
+	// at or below threshold(). Detectors add whatever margin they need on their own.
+	virtual void set_region(const Region &region) = 0;
 };
 
 } /* namespace iptsd::contacts */
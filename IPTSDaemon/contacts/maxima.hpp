@@ -0,0 +1,162 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_CONTACTS_MAXIMA_HPP
+#define IPTSD_CONTACTS_MAXIMA_HPP
+
+#include "region.hpp"
+
+#include <common/types.hpp>
+#include <container/image.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace iptsd::contacts {
+
+/*
+ * Finds local maxima above a threshold, comparing every pixel against its 8 neighbours.
+ *
+ * We use the following kernel to compare entries:
+ *
+ *   [< ] [< ] [< ]
+ *   [< ] [  ] [<=]
+ *   [<=] [<=] [<=]
+ *
+ * Half of the entries use "less or equal", the other half "less than" as
+ * operators to ensure that we don't either discard any local maximas or
+ * report some multiple times.
+ *
+ * The image is copied into a buffer with a border of -inf around it, which always
+ * compares as smaller. This way every row can be processed four pixels at a time,
+ * without any special cases for the edges. The maxima are reported in row-major order.
+ *
+ * If a region is given, only the maxima inside of it are searched, and everything outside
+ * of it is treated like the border. This is exact as long as the values outside are not
+ * above the threshold.
+ */
+class LocalMaxima {
+private:
+	static constexpr index_t lanes = 4;
+
+	container::Image<f32> padded {};
+
+public:
+	void find(const container::Image<f32> &data, f32 threshold, std::vector<index_t> &out);
+	void find(const container::Image<f32> &data, f32 threshold, const Region &region,
+		  std::vector<index_t> &out);
+
+private:
+	void pad(const container::Image<f32> &data, const Region &region);
+};
+
+inline void LocalMaxima::pad(const container::Image<f32> &data, const Region &region)
+{
+	const index2_t size = data.size();
+
+	// One pixel on every side, and enough room to round any row up to a multiple of the lanes.
+	// The buffer has the same layout as the image, so that it never needs to be reallocated.
+	const index2_t padded_size {size.x + lanes + 2, size.y + 2};
+
+	if (this->padded.size() != padded_size)
+		this->padded = container::Image<f32> {padded_size};
+
+	const f32 inf = std::numeric_limits<f32>::infinity();
+	const index2_t extent = region.size();
+	const index_t width = (extent.x + lanes - 1) / lanes * lanes;
+
+	// Everything that is read around the region has to be -inf, including the rounding.
+	f32 *top = &this->padded[index2_t {region.min.x, region.min.y}];
+	f32 *bottom = &this->padded[index2_t {region.min.x, region.max.y + 1}];
+
+	std::fill_n(top, width + 2, -inf);
+	std::fill_n(bottom, width + 2, -inf);
+
+	for (index_t y = region.min.y; y < region.max.y; y++) {
+		const f32 *src = &data[index2_t {region.min.x, y}];
+		f32 *dst = &this->padded[index2_t {region.min.x, y + 1}];
+
+		dst[0] = -inf;
+		std::memcpy(dst + 1, src, sizeof(f32) * extent.x);
+		std::fill(dst + 1 + extent.x, dst + 2 + width, -inf);
+	}
+}
+
+inline void LocalMaxima::find(const container::Image<f32> &data, f32 threshold,
+			      std::vector<index_t> &out)
+{
+	this->find(data, threshold, Region {index2_t {0, 0}, data.size()}, out);
+}
+
+inline void LocalMaxima::find(const container::Image<f32> &data, f32 threshold,
+			      const Region &region, std::vector<index_t> &out)
+{
+	if (region.empty())
+		return;
+
+	this->pad(data, region);
+
+	const index2_t size = data.size();
+	const index2_t extent = region.size();
+	const index_t stride = this->padded.stride();
+
+	for (index_t y = region.min.y; y < region.max.y; y++) {
+		const f32 *row = &this->padded[index2_t {region.min.x + 1, y + 1}];
+
+		for (index_t x = 0; x < extent.x; x += lanes) {
+			const f32 *p = row + x;
+			u32 mask = 0;
+
+#if defined(__SSE2__)
+			const __m128 c = _mm_loadu_ps(p);
+			__m128 max = _mm_cmpgt_ps(c, _mm_set1_ps(threshold));
+
+			max = _mm_and_ps(max, _mm_cmplt_ps(_mm_loadu_ps(p - stride - 1), c));
+			max = _mm_and_ps(max, _mm_cmplt_ps(_mm_loadu_ps(p - stride), c));
+			max = _mm_and_ps(max, _mm_cmplt_ps(_mm_loadu_ps(p - stride + 1), c));
+			max = _mm_and_ps(max, _mm_cmplt_ps(_mm_loadu_ps(p - 1), c));
+			max = _mm_and_ps(max, _mm_cmple_ps(_mm_loadu_ps(p + 1), c));
+			max = _mm_and_ps(max, _mm_cmple_ps(_mm_loadu_ps(p + stride - 1), c));
+			max = _mm_and_ps(max, _mm_cmple_ps(_mm_loadu_ps(p + stride), c));
+			max = _mm_and_ps(max, _mm_cmple_ps(_mm_loadu_ps(p + stride + 1), c));
+
+			mask = static_cast<u32>(_mm_movemask_ps(max));
+#else
+			for (index_t i = 0; i < lanes; i++) {
+				const f32 *q = p + i;
+				const f32 c = *q;
+
+				bool max = c > threshold;
+
+				max &= q[-stride - 1] < c;
+				max &= q[-stride] < c;
+				max &= q[-stride + 1] < c;
+				max &= q[-1] < c;
+				max &= q[1] <= c;
+				max &= q[stride - 1] <= c;
+				max &= q[stride] <= c;
+				max &= q[stride + 1] <= c;
+
+				mask |= static_cast<u32>(max) << i;
+			}
+#endif
+
+			// The padding at the end of a row is never a maximum, so no need to check x
+			while (mask != 0) {
+				const index_t i = __builtin_ctz(mask);
+				mask &= mask - 1;
+
+				out.push_back(y * size.x + region.min.x + x + i);
+			}
+		}
+	}
+}
+
+} /* namespace iptsd::contacts */
+
+#endif /* IPTSD_CONTACTS_MAXIMA_HPP */
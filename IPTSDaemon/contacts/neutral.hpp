@@ -8,49 +8,113 @@
 #include <common/types.hpp>
 #include <container/image.hpp>
 #include <container/ops.hpp>
-#include <math/mat2.hpp>
-#include <math/vec2.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
 #include <gsl/gsl>
-#include <vector>
+#include <iterator>
+#include <stdexcept>
 
 namespace iptsd::contacts {
 
-inline f32 neutral_mode(const container::Image<f32> &data)
-{
-	const index2_t size = data.size();
-	std::array<u32, UINT8_MAX + 1> count {};
+/*
+ * Estimates the neutral value of the heatmap.
+ *
+ * Instead of going over the heatmap again, this uses the histogram that the normalizer builds
+ * anyway (see NormalizeStats). It counts the normalized values, clamped to [0, 1] and quantized
+ * to 256 bins, not the raw sensor values. The histogram is smoothed over multiple frames, so
+ * that the neutral value doesn't jump around, and the detectors only need to be told about
+ * changes.
+ *
+ * Since only the bins are known, AVERAGE mode counts every value at the center of its bin.
+ * Unlike the exact per-pixel average that was used before, the result is therefore quantized,
+ * and values outside of [0, 1] only count as 0 or 1.
+ */
+class NeutralEstimator {
+private:
+	// How much a new frame contributes to the smoothed histogram.
+	static constexpr f32 smoothing = 0.25f;
+
+	enum NeutralMode mode;
+	f32 offset;
+
+	bool initialized = false;
+	std::array<f32, UINT8_MAX + 1> histogram {};
+
+	f32 neutral;
+
+public:
+	NeutralEstimator(enum NeutralMode mode, f32 offset)
+		: mode {mode}, offset {offset / 255}, neutral {offset / 255} {};
+
+	// Returns true if the neutral value has changed.
+	bool update(const container::ops::NormalizeStats &stats);
+
+	[[nodiscard]] f32 value() const;
+
+private:
+	[[nodiscard]] f32 estimate() const;
+};
 
-	for (index_t x = 0; x < size.x; x++) {
-		for (index_t y = 0; y < size.y; y++) {
-			const index2_t pos {x, y};
+inline bool NeutralEstimator::update(const container::ops::NormalizeStats &stats)
+{
+	if (this->mode == NeutralMode::CONSTANT)
+		return false;
 
-			const u8 val = gsl::narrow_cast<u8>(data[pos] * UINT8_MAX);
-			count.at(val)++;
+	if (!this->initialized) {
+		std::copy(stats.histogram.begin(), stats.histogram.end(), this->histogram.begin());
+		this->initialized = true;
+	} else {
+		for (std::size_t i = 0; i < this->histogram.size(); i++) {
+			const f32 count = gsl::narrow_cast<f32>(stats.histogram[i]);
+			this->histogram[i] += (count - this->histogram[i]) * smoothing;
 		}
 	}
 
-	const auto max = std::max_element(count.begin(), count.end());
-	const u32 idx = (u32)std::distance(count.begin(), max);
+	const f32 value = this->estimate() + this->offset;
+
+	/*
+	 * The smoothed histogram hardly ever settles on exactly the same value. Changes below
+	 * half a sensor step are ignored, they would only make the detectors start over. Since
+	 * the value is compared to the last one that was reported, slow drift still gets through.
+	 */
+	if (std::abs(value - this->neutral) < 0.5f / UINT8_MAX)
+		return false;
 
-	return gsl::narrow<f32>(idx + 1) / UINT8_MAX;
+	this->neutral = value;
+	return true;
 }
 
-inline f32 neutral_average(const container::Image<f32> &data)
+inline f32 NeutralEstimator::value() const
 {
-	const f32 sum = container::ops::sum(data);
-	return sum / gsl::narrow<f32>(data.size().span());
+	return this->neutral;
 }
 
-inline f32 neutral(const BlobDetectorConfig &config, const container::Image<f32> &data)
+inline f32 NeutralEstimator::estimate() const
 {
-	switch (config.neutral_mode) {
-	case NeutralMode::MODE:
-		return neutral_mode(data) + (config.neutral_value / 255);
-	case NeutralMode::AVERAGE:
-		return neutral_average(data) + (config.neutral_value / 255);
+	switch (this->mode) {
+	case NeutralMode::MODE: {
+		const auto max = std::max_element(this->histogram.begin(), this->histogram.end());
+		const auto idx = std::distance(this->histogram.begin(), max);
+
+		return gsl::narrow<f32>(idx + 1) / UINT8_MAX;
+	}
+	case NeutralMode::AVERAGE: {
+		f32 sum = 0;
+		f32 count = 0;
+
+		// Bin i covers the normalized values [i, i + 1) / 255, so use its center
+		for (std::size_t i = 0; i < this->histogram.size(); i++) {
+			sum += this->histogram[i] * (gsl::narrow_cast<f32>(i) + 0.5f);
+			count += this->histogram[i];
+		}
+
+		return count > 0 ? sum / count / UINT8_MAX : 0;
+	}
 	case NeutralMode::CONSTANT:
-		return config.neutral_value / 255;
+		return 0;
 	default:
 		throw std::runtime_error("Invalid neutral mode!");
 	}
@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_CONTACTS_PREDICTOR_HPP
+#define IPTSD_CONTACTS_PREDICTOR_HPP
+
+#include <common/types.hpp>
+#include <math/vec2.hpp>
+
+namespace iptsd::contacts {
+
+/*
+ * An alpha-beta filter for the position of a single contact, which assumes that the contact
+ * moves with a constant velocity between two frames.
+ *
+ * Every update compares the measured position with the one that was expected from the last
+ * position and velocity. alpha is the part of that difference that is applied to the position,
+ * beta the part that is applied to the velocity. Higher values react faster to changes of
+ * direction, lower values smooth out more noise and overshoot less.
+ */
+template <class T> class Predictor {
+private:
+	T alpha;
+	T beta;
+
+	bool valid = false;
+	math::Vec2<T> position {};
+	math::Vec2<T> velocity {};
+
+public:
+	// The defaults are the same as the ones of the config.
+	Predictor(T alpha = 0.8, T beta = 0.3) : alpha {alpha}, beta {beta} {};
+
+	// Forgets the contact, the next update starts over without any velocity.
+	void reset();
+
+	// Adds a new measurement, dt seconds after the last one.
+	void update(math::Vec2<T> measured, T dt);
+
+	// Where the contact will be in the given amount of seconds.
+	[[nodiscard]] math::Vec2<T> predict(T time) const;
+};
+
+template <class T> inline void Predictor<T>::reset()
+{
+	this->valid = false;
+}
+
+template <class T> inline void Predictor<T>::update(math::Vec2<T> measured, T dt)
+{
+	if (!this->valid || dt <= 0) {
+		this->valid = true;
+		this->position = measured;
+		this->velocity = math::Vec2<T> {};
+		return;
+	}
+
+	const math::Vec2<T> expected = this->position + this->velocity * dt;
+	const math::Vec2<T> residual = measured - expected;
+
+	this->position = expected + residual * this->alpha;
+	this->velocity += residual * (this->beta / dt);
+}
+
+template <class T> inline math::Vec2<T> Predictor<T>::predict(T time) const
+{
+	return this->position + this->velocity * time;
+}
+
+} /* namespace iptsd::contacts */
+
+#endif /* IPTSD_CONTACTS_PREDICTOR_HPP */
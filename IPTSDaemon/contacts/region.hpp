@@ -0,0 +1,142 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_CONTACTS_REGION_HPP
+#define IPTSD_CONTACTS_REGION_HPP
+
+#include <common/types.hpp>
+#include <container/image.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace iptsd::contacts {
+
+/*
+ * A rectangular part of the heatmap. min is inclusive, max is exclusive.
+ */
+struct Region {
+	index2_t min {0, 0};
+	index2_t max {0, 0};
+
+	[[nodiscard]] index2_t size() const;
+	[[nodiscard]] bool empty() const;
+
+	// Grows the region by margin on every side, without leaving an image of the given size.
+	[[nodiscard]] Region grow(index_t margin, index2_t limit) const;
+};
+
+/*
+ * Divides the heatmap into tiles, and remembers which of them contained a value
+ * above the threshold, in this frame and the one before. Outside of the active tiles,
+ * the heatmap is at or below the threshold, so the detectors can skip it.
+ *
+ * Including the previous frame makes sure that the area a contact is moving away from
+ * is still looked at for one more frame.
+ */
+class TileMap {
+public:
+	static constexpr index_t tile = 8;
+
+private:
+	index2_t size {0, 0};
+	index2_t tiles {0, 0};
+
+	std::vector<u8> current {};
+	std::vector<u8> previous {};
+
+public:
+	TileMap() = default;
+	TileMap(index2_t size);
+
+	void update(const container::Image<f32> &data, f32 threshold);
+
+	// Starts a new frame in which no tile is active.
+	void clear();
+
+	// The bounding box of all active tiles. Empty if there are none.
+	[[nodiscard]] Region region() const;
+};
+
+inline index2_t Region::size() const
+{
+	return this->max - this->min;
+}
+
+inline bool Region::empty() const
+{
+	return this->max.x <= this->min.x || this->max.y <= this->min.y;
+}
+
+inline Region Region::grow(index_t margin, index2_t limit) const
+{
+	return Region {
+		index2_t {std::max(this->min.x - margin, 0), std::max(this->min.y - margin, 0)},
+		index2_t {std::min(this->max.x + margin, limit.x),
+			  std::min(this->max.y + margin, limit.y)},
+	};
+}
+
+inline TileMap::TileMap(index2_t size)
+	: size {size}, tiles {(size.x + tile - 1) / tile, (size.y + tile - 1) / tile},
+	  current(tiles.span()), previous(tiles.span())
+{
+}
+
+inline void TileMap::update(const container::Image<f32> &data, f32 threshold)
+{
+	this->clear();
+
+	for (index_t y = 0; y < this->size.y; y++) {
+		const f32 *row = &data[index2_t {0, y}];
+		u8 *flags = &this->current[(y / tile) * this->tiles.x];
+
+		for (index_t tx = 0; tx < this->tiles.x; tx++) {
+			const index_t start = tx * tile;
+			const index_t end = std::min(start + tile, this->size.x);
+
+			f32 max = row[start];
+			for (index_t x = start + 1; x < end; x++)
+				max = std::max(max, row[x]);
+
+			flags[tx] |= static_cast<u8>(max > threshold);
+		}
+	}
+}
+
+inline void TileMap::clear()
+{
+	std::swap(this->current, this->previous);
+	std::fill(this->current.begin(), this->current.end(), 0);
+}
+
+inline Region TileMap::region() const
+{
+	index2_t min = this->tiles;
+	index2_t max {0, 0};
+
+	for (index_t ty = 0; ty < this->tiles.y; ty++) {
+		for (index_t tx = 0; tx < this->tiles.x; tx++) {
+			const index_t i = ty * this->tiles.x + tx;
+
+			if (!this->current[i] && !this->previous[i])
+				continue;
+
+			min.x = std::min(min.x, tx);
+			min.y = std::min(min.y, ty);
+			max.x = std::max(max.x, tx + 1);
+			max.y = std::max(max.y, ty + 1);
+		}
+	}
+
+	if (max.x <= min.x || max.y <= min.y)
+		return Region {};
+
+	return Region {
+		index2_t {min.x * tile, min.y * tile},
+		index2_t {std::min(max.x * tile, this->size.x), std::min(max.y * tile, this->size.y)},
+	};
+}
+
+} /* namespace iptsd::contacts */
+
+#endif /* IPTSD_CONTACTS_REGION_HPP */
@@ -33,6 +33,9 @@ public:
 	[[nodiscard]] auto size() const -> index2_t;
 	[[nodiscard]] auto stride() const -> index_t;
 
+	// Changes the size without giving back memory, the contents are unspecified afterwards.
+	void resize(index2_t size);
+
 	auto data() -> pointer;
 	[[nodiscard]] auto data() const -> const_pointer;
 
@@ -77,6 +80,12 @@ template <class T> inline auto Image<T>::stride() const -> index_t
 	return m_size.x;
 }
 
+template <class T> inline void Image<T>::resize(index2_t size)
+{
+	m_size = size;
+	m_data.resize(size.span());
+}
+
 template <class T> inline auto Image<T>::data() -> pointer
 {
 	return m_data.data();
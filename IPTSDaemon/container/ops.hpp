@@ -3,10 +3,13 @@
 #ifndef IPTSD_CONTAINER_OPS_HPP
 #define IPTSD_CONTAINER_OPS_HPP
 
+#include <common/types.hpp>
 #include <math/num.hpp>
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <gsl/gsl>
 #include <numeric>
 #include <utility>
 
@@ -51,6 +54,110 @@ template <class C> inline auto sum(C const &container) -> typename C::value_type
 	return std::accumulate(container.begin(), container.end(), math::num<T>::zero);
 }
 
+struct NormalizeStats {
+	// The largest value that was written.
+	f32 max = 0;
+
+	// How often each value occurred, after mapping it back to the range [0, 255].
+	std::array<u32, UINT8_MAX + 1> histogram {};
+};
+
+/*
+ * Normalizes and inverts 8-bit sensor data, so that min becomes 1 and max becomes 0.
+ * All possible results are stored in a lookup table, which is only rebuilt when the range changes.
+ */
+class Normalizer {
+public:
+	void update(u8 min, u8 max);
+
+	template <class T> void apply(gsl::span<const u8> source, T &target, NormalizeStats &stats);
+
+private:
+	bool m_valid = false;
+	u8 m_min = 0;
+	u8 m_max = 0;
+
+	std::array<f32, UINT8_MAX + 1> m_value {};
+	std::array<u8, UINT8_MAX + 1> m_bin {};
+
+	// Using multiple histograms breaks the dependency between increments of the same bin,
+	// which are very common since most of the heatmap has the same value.
+	std::array<std::array<u32, UINT8_MAX + 1>, 4> m_count {};
+};
+
+inline void Normalizer::update(u8 min, u8 max)
+{
+	if (m_valid && m_min == min && m_max == max)
+		return;
+
+	for (std::size_t i = 0; i < m_value.size(); i++) {
+		const f32 val = (static_cast<f32>(i) - static_cast<f32>(min)) /
+				static_cast<f32>(max - min);
+
+		m_value[i] = 1.0f - val;
+
+		const f32 clamped = std::clamp(m_value[i], 0.0f, 1.0f);
+		m_bin[i] = gsl::narrow_cast<u8>(clamped * UINT8_MAX);
+	}
+
+	m_valid = true;
+	m_min = min;
+	m_max = max;
+}
+
+template <class T>
+inline void Normalizer::apply(gsl::span<const u8> source, T &target, NormalizeStats &stats)
+{
+	assert(m_valid);
+
+	for (auto &count : m_count)
+		std::fill(count.begin(), count.end(), 0);
+
+	const std::size_t size = source.size();
+	const u8 *in = source.data();
+	auto *out = target.data();
+
+	std::size_t i = 0;
+
+	// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+	for (; i + 4 <= size; i += 4) {
+		const u8 v0 = in[i + 0];
+		const u8 v1 = in[i + 1];
+		const u8 v2 = in[i + 2];
+		const u8 v3 = in[i + 3];
+
+		out[i + 0] = m_value[v0];
+		out[i + 1] = m_value[v1];
+		out[i + 2] = m_value[v2];
+		out[i + 3] = m_value[v3];
+
+		m_count[0][v0]++;
+		m_count[1][v1]++;
+		m_count[2][v2]++;
+		m_count[3][v3]++;
+	}
+
+	for (; i < size; i++) {
+		out[i] = m_value[in[i]];
+		m_count[0][in[i]]++;
+	}
+	// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+	// Fold the raw counts into the histogram of the normalized values
+	std::fill(stats.histogram.begin(), stats.histogram.end(), 0);
+	stats.max = size > 0 ? m_value[in[0]] : 0.0f;
+
+	for (std::size_t v = 0; v < m_value.size(); v++) {
+		const u32 count = m_count[0][v] + m_count[1][v] + m_count[2][v] + m_count[3][v];
+
+		if (count == 0)
+			continue;
+
+		stats.histogram[m_bin[v]] += count;
+		stats.max = std::max(stats.max, m_value[v]);
+	}
+}
+
 } /* namespace iptsd::container::ops */
 
 #endif /* IPTSD_CONTAINER_OPS_HPP */
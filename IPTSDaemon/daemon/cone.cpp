@@ -7,28 +7,40 @@
 #include <chrono>
 #include <cmath>
 #include <gsl/gsl>
+#include <mutex>
 
 namespace iptsd::daemon {
 
 bool Cone::alive()
 {
+	const std::lock_guard<std::mutex> guard {this->lock};
 	return this->position_update > clock::from_time_t(0);
 }
 
 void Cone::update_position(f64 x, f64 y)
 {
+	const std::lock_guard<std::mutex> guard {this->lock};
+
 	this->x = x;
 	this->y = y;
 	this->position_update = clock::now();
 }
 
 bool Cone::active()
+{
+	const std::lock_guard<std::mutex> guard {this->lock};
+	return this->is_active();
+}
+
+bool Cone::is_active() const
 {
 	return this->position_update + std::chrono::milliseconds(300) > clock::now();
 }
 
 void Cone::update_direction(f64 x, f64 y)
 {
+	const std::lock_guard<std::mutex> guard {this->lock};
+
 	const clock::time_point timestamp = clock::now();
 
 	const auto time_diff = timestamp - this->direction_update;
@@ -53,7 +65,9 @@ void Cone::update_direction(f64 x, f64 y)
 
 bool Cone::check(f64 x, f64 y)
 {
-	if (!this->active())
+	const std::lock_guard<std::mutex> guard {this->lock};
+
+	if (!this->is_active())
 		return false;
 
 	const f64 dx = x - this->x;
@@ -7,9 +7,14 @@
 #include <math/num.hpp>
 
 #include <chrono>
+#include <mutex>
 
 namespace iptsd::daemon {
 
+/*
+ * The stylus thread moves the cone, while the touch thread turns and checks it,
+ * so all of the functions below are synchronized.
+ */
 class Cone {
 public:
 	using clock = std::chrono::system_clock;
@@ -36,6 +41,11 @@ public:
 	void update_direction(f64 x, f64 y);
 
 	bool check(f64 x, f64 y);
+
+private:
+	std::mutex lock {};
+
+	bool is_active() const;
 };
 
 } /* namespace iptsd::daemon */
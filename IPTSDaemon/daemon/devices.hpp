@@ -9,6 +9,7 @@
 #include <config/config.hpp>
 #include <contacts/finder.hpp>
 
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -16,7 +17,8 @@ namespace iptsd::daemon {
 
 class StylusDevice {
 public:
-	bool active = false;
+	// Written by the stylus thread, read by the touch thread.
+	std::atomic_bool active = false;
 	std::shared_ptr<Cone> cone;
 
 public:
@@ -10,7 +10,10 @@
 #include <common/types.hpp>
 #include <config/config.hpp>
 #include <ipts/device.hpp>
+#include <ipts/interface.hpp>
+#include <ipts/memory.hpp>
 #include <ipts/parser.hpp>
+#include <ipts/replay.hpp>
 
 #include <atomic>
 #include <chrono>
@@ -20,24 +23,117 @@
 #include <exception>
 #include <filesystem>
 #include <functional>
+#include <gsl/gsl>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <spdlog/spdlog.h>
 #include <stdexcept>
+#include <string>
 #include <thread>
 
 using namespace std::chrono;
 
 namespace iptsd::daemon {
 
-static int start()
+/*
+ * Receives the parsed data. Since the parser knows this type at compile time,
+ * all of the handlers below get inlined into the parsing loop.
+ *
+ * The stylus is handled right here, on the thread that reads from the device.
+ * Heatmaps are handed over to the touch thread.
+ */
+class DaemonSink {
+private:
+	Context &ctx;
+	ipts::IDevice &device;
+	TouchThread &touch;
+
+public:
+	DaemonSink(Context &ctx, ipts::IDevice &device, TouchThread &touch)
+		: ctx {ctx}, device {device}, touch {touch} {};
+
+	void stylus_input(const ipts::StylusData &data)
+	{
+		if (ctx.config.stylus_disable)
+			return;
+
+		// The report is only queued, all of them are sent once the buffer is parsed
+		IPTSHIDReport report;
+		memset(&report, 0, sizeof(IPTSHIDReport));
+		iptsd_stylus_input(ctx, data, report);
+		device.send_hid_report(report);
+	}
+
+	void dft_input(const ipts::DftWindow &dft, ipts::StylusData &stylus)
+	{
+		if (ctx.config.stylus_disable)
+			return;
+
+		iptsd_dft_input(ctx, dft, stylus);
+		this->stylus_input(stylus);
+	}
+
+	void heatmap_input(const ipts::Heatmap &data)
+	{
+		if (ctx.config.touch_disable)
+			return;
+
+		if (ctx.devices.stylus->active && ctx.config.touch_disable_on_stylus)
+			return;
+
+		// The heatmap points into the input buffer, so this has to happen
+		// before processing ends. It is only a copy, the search runs later.
+		touch.push(data);
+	}
+};
+
+static void log_telemetry(const ipts::Telemetry &telemetry, steady_clock::duration interval)
+{
+	const f64 secs = duration_cast<duration<f64>>(interval).count();
+
+	const auto log = [&](const std::string &name, const ipts::ReportStats &stats) {
+		const f64 avg = static_cast<f64>(stats.nanoseconds) / static_cast<f64>(stats.count);
+
+		spdlog::info("{}: {:.1f}/s, {:.1f} KiB/s, avg {:.0f}ns, p50 < {}ns, p99 < {}ns", name,
+			     static_cast<f64>(stats.count) / secs,
+			     static_cast<f64>(stats.bytes) / secs / 1024, avg, stats.percentile(0.5),
+			     stats.percentile(0.99));
+	};
+
+	telemetry.for_each([&](u8 type, const ipts::ReportStats &stats) {
+		log(fmt::format("Report 0x{:02X} ({})", type, ipts::report_name(type)), stats);
+	});
+
+	if (telemetry.hid_heatmaps.count > 0)
+		log("HID heatmap frames", telemetry.hid_heatmaps);
+}
+
+static void log_replay(ipts::MemoryDevice &device, steady_clock::duration elapsed)
+{
+	const std::lock_guard<std::mutex> guard {device.lock};
+
+	const f64 secs = duration_cast<duration<f64>>(elapsed).count();
+	const f64 reports = static_cast<f64>(std::max<u64>(device.reports_sent, 1));
+
+	const auto avg = duration_cast<duration<f64, std::micro>>(device.latency_total);
+	const auto max = duration_cast<duration<f64, std::micro>>(device.latency_max);
+
+	spdlog::info("Replayed {} buffers in {:.3f}s ({:.1f}/s), sent {} reports in {} batches",
+		     device.buffers_read, secs, static_cast<f64>(device.buffers_read) / secs,
+		     device.reports_sent, device.submissions);
+	spdlog::info("Latency: avg {:.1f}us, max {:.1f}us", avg.count() / reports, max.count());
+}
+
+static int start(std::unique_ptr<ipts::IDevice> dev)
 {
 	std::atomic_bool should_exit = false;
 
 	auto const _sigterm = common::signal<SIGTERM>([&](int) { should_exit = true; });
 	auto const _sigint = common::signal<SIGINT>([&](int) { should_exit = true; });
 
-	ipts::Device device;
+	ipts::IDevice &device = *dev;
 
     std::optional<IPTSDeviceMetaData> &meta = device.meta_data;
 	if (meta.has_value()) {
@@ -62,38 +158,23 @@ static int start()
 	Context ctx {config, meta};
 	spdlog::info("Connected to device {:04X}:{:04X}", device.vendor_id, device.product_id);
 
-	ipts::Parser parser {};
-    if (!config.stylus_disable) {
-        parser.on_dft = [&](const ipts::DftWindow &dft, ipts::StylusData &stylus) {
-            device.process_end();
-            
-            iptsd_dft_input(ctx, dft, stylus);
-        };
-        parser.on_stylus = [&](const ipts::StylusData &data) {
-            device.process_end();
-            
-            IPTSHIDReport report;
-            memset(&report, 0, sizeof(IPTSHIDReport));
-            iptsd_stylus_input(ctx, data, report);
-            device.send_hid_report(report);
-        };
-    } else
-        spdlog::warn("Stylus is disabled!");
-    
-    if (!config.touch_disable)
-        parser.on_heatmap = [&](const ipts::Heatmap &data) {
-            device.process_end();
-            
-            if (ctx.devices.stylus->active && ctx.config.touch_disable_on_stylus)
-                return;
-            
-            IPTSHIDReport report;
-            memset(&report, 0, sizeof(IPTSHIDReport));
-            if (iptsd_touch_input(ctx, data, report))
-                device.send_hid_report(report);
-            };
-    else
-        spdlog::warn("Touchscreen is disabled!");
+	if (config.stylus_disable)
+		spdlog::warn("Stylus is disabled!");
+
+	if (config.touch_disable)
+		spdlog::warn("Touchscreen is disabled!");
+
+	TouchThread touch {ctx, device};
+
+	DaemonSink sink {ctx, device, touch};
+	ipts::BasicParser<DaemonSink> parser {sink};
+	parser.coalesce_heatmaps = config.touch_coalesce;
+	parser.telemetry.enabled = config.debug_telemetry > 0;
+
+	const seconds telemetry_interval {config.debug_telemetry};
+	auto telemetry_last = steady_clock::now();
+
+	const auto started = steady_clock::now();
 
 	// Count errors, if we receive 10 continuous errors, chances are pretty good that
 	// something is broken beyond repair and the program should exit.
@@ -104,12 +185,28 @@ static int start()
 			break;
 		}
 
+		// The touch thread can't abort on its own
+		if (touch.continuous_errors() >= 10) {
+			spdlog::error("Touch processing encountered 10 continuous errors, aborting...");
+			break;
+		}
+
 		try {
             gsl::span<u8> buffer = device.read();
+			if (device.finished)
+				break;
             
             device.process_begin();
-			parser.parse(buffer);
+			const ipts::ParseStatus status = parser.try_parse(buffer);
+
+			// The buffer is only given back once it is parsed completely and the heatmap
+			// was copied. Then the stylus reports of the whole buffer are sent in one batch.
             device.process_end();
+
+			// A malformed frame is dropped, the device itself is still fine.
+			if (status != ipts::ParseStatus::OK)
+				spdlog::debug("Dropped frame ({} so far): {}", parser.count(status),
+					      ipts::to_string(status));
 		} catch (std::system_error &e) {
             if (device.should_reinit)
                 device.reset();
@@ -128,12 +225,41 @@ static int start()
 
 		// Reset error count
 		errors = 0;
+
+		if (parser.telemetry.enabled) {
+			const auto now = steady_clock::now();
+
+			if (now - telemetry_last >= telemetry_interval) {
+				log_telemetry(parser.telemetry, now - telemetry_last);
+				parser.telemetry.reset();
+				telemetry_last = now;
+			}
+		}
 	}
 
     spdlog::info("Stopping");
+
+	// Waits for the last heatmaps, the statistics below are only complete afterwards
+	touch.stop();
+
+	if (parser.coalesce_heatmaps)
+		spdlog::info("Dropped {} stale heatmaps", parser.dropped_heatmaps());
+
+	if (touch.dropped_heatmaps() > 0)
+		spdlog::info("Touch processing fell behind {} times", touch.dropped_heatmaps());
+
+	const contacts::IdleStats &idle = ctx.devices.touch->finder.idle_stats();
+	if (idle.frames > 0)
+		spdlog::info("Skipped detection for {} of {} heatmaps ({:.1f}%)", idle.skipped,
+			     idle.frames,
+			     static_cast<f64>(idle.skipped) / static_cast<f64>(idle.frames) * 100);
+
+	if (auto *memory = dynamic_cast<ipts::MemoryDevice *>(&device))
+		log_replay(*memory, steady_clock::now() - started);
+
     device.process_end();
-	// If iptsd was stopped from outside, return no error
-	if (!should_exit)
+	// If iptsd was stopped from outside, or the replay has ended, return no error
+	if (!should_exit && !device.finished)
 		return EXIT_FAILURE;
 
 	return 0;
@@ -145,8 +271,30 @@ int main(int argc, char **argv)
 {
 	spdlog::set_pattern("[%X.%e] [%^%l%$] %v");
 
+	// IPTSDaemon [dump [interval [slots]]] replays a file recorded by IPTSDump instead of
+	// talking to the driver. The interval between buffers is given in microseconds.
+	// If a number of slots is given, the buffers are passed through an input ring.
+	if (argc > 4) {
+		spdlog::error("Usage: {} [dump [interval [slots]]]", argv[0]);
+		return EXIT_FAILURE;
+	}
+
 	try {
-		return iptsd::daemon::start();
+		std::unique_ptr<iptsd::ipts::IDevice> device;
+
+		if (argc >= 2) {
+			const microseconds interval(argc >= 3 ? std::stoul(argv[2]) : 0);
+			auto replay = std::make_unique<iptsd::ipts::ReplayDevice>(argv[1], interval);
+
+			if (argc == 4)
+				replay->use_ring(gsl::narrow<u32>(std::stoul(argv[3])));
+
+			device = std::move(replay);
+		} else {
+			device = std::make_unique<iptsd::ipts::Device>();
+		}
+
+		return iptsd::daemon::start(std::move(device));
 	} catch (std::exception &e) {
 		spdlog::error(e.what());
 		return EXIT_FAILURE;
@@ -9,6 +9,10 @@
 #include <ipts/parser.hpp>
 #include <ipts/protocol.hpp>
 
+#include <exception>
+#include <gsl/gsl>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 namespace iptsd::daemon {
@@ -45,7 +49,7 @@ static void update_cone(Context &ctx, const contacts::Contact &contact)
 	touch.cone->update_direction(x, y);
 }
 
-static bool check_blocked(const Context &ctx, const std::vector<contacts::Contact> &contacts)
+static bool check_blocked(const Context &ctx, gsl::span<const contacts::Contact> contacts)
 {
     if (ctx.config.touch_disable_on_palm) {
         for (const auto &p : contacts)
@@ -56,7 +60,7 @@ static bool check_blocked(const Context &ctx, const std::vector<contacts::Contac
 	return false;
 }
 
-bool iptsd_touch_input(Context &ctx, const ipts::Heatmap &data, IPTSHIDReport &report)
+void iptsd_touch_load(Context &ctx, const ipts::Heatmap &data)
 {
 	TouchDevice &touch = *ctx.devices.touch;
 
@@ -64,16 +68,15 @@ bool iptsd_touch_input(Context &ctx, const ipts::Heatmap &data, IPTSHIDReport &r
 	touch.finder.resize(index2_t {data.dim.width, data.dim.height});
 
 	// Normalize and invert the heatmap data.
-	std::transform(data.data.begin(), data.data.end(), touch.finder.data().begin(),
-		       [&](auto v) {
-			       f32 val = static_cast<f32>(v - data.dim.z_min) /
-					 static_cast<f32>(data.dim.z_max - data.dim.z_min);
+	touch.finder.load(data.data, data.dim.z_min, data.dim.z_max, data.time.timestamp);
+}
 
-			       return 1.0f - val;
-		       });
+bool iptsd_touch_input(Context &ctx, IPTSHIDReport &report)
+{
+	TouchDevice &touch = *ctx.devices.touch;
 
 	// Search for contacts
-	const std::vector<contacts::Contact> &contacts = touch.finder.search();
+	const gsl::span<const contacts::Contact> contacts = touch.finder.search();
 
 	// Update stylus rejection cones
 	for (const auto &contact : contacts)
@@ -103,4 +106,112 @@ bool iptsd_touch_input(Context &ctx, const ipts::Heatmap &data, IPTSHIDReport &r
     return true;
 }
 
+TouchThread::TouchThread(Context &ctx, ipts::IDevice &device) : ctx {ctx}, device {device}
+{
+	// Nothing will be pushed, and the contact finder is never used
+	if (ctx.config.touch_disable)
+		return;
+
+	this->thread = std::thread {[this] { this->run(); }};
+}
+
+TouchThread::~TouchThread()
+{
+	this->stop();
+}
+
+void TouchThread::stop()
+{
+	if (!this->thread.joinable())
+		return;
+
+	this->stopping = true;
+	this->notify();
+
+	this->thread.join();
+}
+
+void TouchThread::push(const ipts::Heatmap &data)
+{
+	Frame *frame = this->queue.back();
+
+	if (!frame) {
+		this->dropped++;
+		return;
+	}
+
+	frame->dim = data.dim;
+	frame->time = data.time;
+	frame->data.assign(data.data.begin(), data.data.end());
+
+	this->queue.push();
+	this->notify();
+}
+
+u64 TouchThread::dropped_heatmaps() const
+{
+	return this->dropped;
+}
+
+u32 TouchThread::continuous_errors() const
+{
+	return this->errors;
+}
+
+void TouchThread::notify()
+{
+	// Taking the lock makes sure that the thread is either asleep or will see the new state
+	{
+		const std::lock_guard<std::mutex> guard {this->lock};
+	}
+
+	this->wakeup.notify_one();
+}
+
+void TouchThread::run()
+{
+	while (true) {
+		Frame *frame = nullptr;
+
+		{
+			std::unique_lock<std::mutex> guard {this->lock};
+			this->wakeup.wait(guard, [&] {
+				frame = this->queue.front();
+				return this->stopping || frame;
+			});
+		}
+
+		// Process what is left in the queue before stopping, e.g. the end of a replay
+		if (this->stopping && !frame)
+			break;
+
+		try {
+			const ipts::Heatmap heatmap {frame->dim, frame->time, frame->data};
+			iptsd_touch_load(this->ctx, heatmap);
+		} catch (std::exception &e) {
+			spdlog::warn(e.what());
+			this->errors++;
+
+			this->queue.pop();
+			continue;
+		}
+
+		// The heatmap was copied into the contact finder, so the slot can be reused
+		this->queue.pop();
+
+		try {
+			IPTSHIDReport report {};
+			if (iptsd_touch_input(this->ctx, report))
+				this->device.send_hid_reports(gsl::span<const IPTSHIDReport>(&report, 1));
+		} catch (std::exception &e) {
+			spdlog::warn(e.what());
+			this->errors++;
+
+			continue;
+		}
+
+		this->errors = 0;
+	}
+}
+
 } // namespace iptsd::daemon
@@ -5,13 +5,80 @@
 
 #include "context.hpp"
 
+#include <common/queue.hpp>
+#include <common/types.hpp>
+#include <ipts/interface.hpp>
 #include <ipts/parser.hpp>
+#include <ipts/protocol.hpp>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <spdlog/spdlog.h>
+#include <thread>
+#include <vector>
 
 namespace iptsd::daemon {
 
-bool iptsd_touch_input(Context &ctx, const ipts::Heatmap &data, IPTSHIDReport &report);
+void iptsd_touch_load(Context &ctx, const ipts::Heatmap &data);
+bool iptsd_touch_input(Context &ctx, IPTSHIDReport &report);
+
+/*
+ * Runs contact detection on its own thread, so that a slow heatmap can't delay the stylus.
+ *
+ * Heatmaps are copied out of the input buffer into a small lock-free queue.
+ * If the thread can't keep up and the queue is full, new heatmaps are dropped.
+ * The thread is not started if the touchscreen is disabled.
+ */
+class TouchThread {
+private:
+	struct Frame {
+		struct ipts_dimensions dim {};
+		struct ipts_timestamp time {};
+		std::vector<u8> data {};
+	};
+
+	Context &ctx;
+	ipts::IDevice &device;
+
+	common::SpscQueue<Frame, 4> queue {};
+	u64 dropped = 0;
+
+	// Only used to sleep while the queue is empty.
+	std::mutex lock {};
+	std::condition_variable wakeup {};
+
+	// Errors in a row, the main loop gives up if there are too many.
+	std::atomic<u32> errors = 0;
+
+	std::atomic_bool stopping = false;
+	std::thread thread;
+
+public:
+	TouchThread(Context &ctx, ipts::IDevice &device);
+	~TouchThread();
+
+	TouchThread(const TouchThread &) = delete;
+	TouchThread &operator=(const TouchThread &) = delete;
+
+	// Must always be called from the same thread.
+	void push(const ipts::Heatmap &data);
+
+	/*
+	 * Processes the heatmaps that are still queued and waits for the thread to exit.
+	 * The contact finder may only be accessed from other threads after this was called.
+	 */
+	void stop();
+
+	[[nodiscard]] u64 dropped_heatmaps() const;
+
+	// How many heatmaps in a row failed to be processed. May be called from any thread.
+	[[nodiscard]] u32 continuous_errors() const;
+
+private:
+	void run();
+	void notify();
+};
 
 } /* namespace iptsd::daemon */
 
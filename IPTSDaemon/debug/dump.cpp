@@ -2,8 +2,8 @@
 
 #include <common/signal.hpp>
 #include <ipts/device.hpp>
+#include <ipts/dump.hpp>
 #include <ipts/protocol.hpp>
-#include "dump.hpp"
 
 #include <cstddef>
 #include <cstdint>
@@ -105,7 +105,7 @@ static int main(char *dump_file)
 
     std::optional<IPTSDeviceMetaData> &meta = dev.meta_data;
 	if (file) {
-		struct debug::iptsd_dump_header header {};
+		struct ipts::iptsd_dump_header header {};
 		header.vendor = dev.vendor_id;
         header.product = dev.product_id;
 
@@ -1,13 +0,0 @@
-#ifndef IPTSD_DEBUG_DUMP_HPP
-#define IPTSD_DEBUG_DUMP_HPP
-
-namespace iptsd::debug {
-
-struct iptsd_dump_header {
-    i16 vendor;
-    i16 product;
-};
-
-} // namespace iptsd::debug
-
-#endif /* IPTSD_DEBUG_DUMP_HPP */
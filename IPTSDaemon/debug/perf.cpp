@@ -2,14 +2,26 @@
 
 #include <common/types.hpp>
 #include <config/config.hpp>
+#include <contacts/advanced/algorithm/convolution.hpp>
+#include <contacts/advanced/algorithm/derivatives.hpp>
+#include <contacts/advanced/algorithm/hessian.hpp>
+#include <contacts/advanced/algorithm/local_maxima.hpp>
+#include <contacts/advanced/algorithm/structure_tensor.hpp>
+#include <contacts/advanced/algorithm/tensor.hpp>
+#include <contacts/assignment.hpp>
 #include <contacts/finder.hpp>
+#include <contacts/maxima.hpp>
 #include <container/image.hpp>
 #include <container/ops.hpp>
+#include <ipts/dump.hpp>
 #include <ipts/parser.hpp>
-#include "dump.hpp"
+#include <math/mat2.hpp>
+#include <math/num.hpp>
 
 #include <algorithm>
+#include <array>
 #include <chrono>
+#include <cmath>
 #include <exception>
 #include <filesystem>
 #include <fmt/core.h>
@@ -19,7 +31,9 @@
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <random>
 #include <spdlog/spdlog.h>
+#include <string>
 #include <vector>
 
 namespace iptsd::debug::perf {
@@ -30,17 +44,590 @@ static void iptsd_perf_handle_input(contacts::ContactFinder &finder, const ipts:
 	finder.resize(index2_t {data.dim.width, data.dim.height});
 
 	// Normalize and invert the heatmap data.
-	std::transform(data.data.begin(), data.data.end(), finder.data().begin(), [&](f32 v) {
-		const f32 val = (v - static_cast<f32>(data.dim.z_min)) /
-				static_cast<f32>(data.dim.z_max - data.dim.z_min);
-
-		return 1.0f - val;
-	});
+	finder.load(data.data, data.dim.z_min, data.dim.z_max, data.time.timestamp);
 
 	// Search for a contact
 	finder.search();
 }
 
+/*
+ * Compares the shared local maxima kernel against the scalar implementation
+ * of the advanced detector, on the heatmap that was just loaded.
+ */
+class MaximaBenchmark {
+public:
+	using clock = std::chrono::steady_clock;
+
+	clock::duration simd {};
+	clock::duration scalar {};
+	u64 frames = 0;
+	u64 mismatches = 0;
+
+private:
+	contacts::LocalMaxima kernel {};
+	std::vector<index_t> a {};
+	std::vector<index_t> b {};
+
+public:
+	void run(const container::Image<f32> &data)
+	{
+		constexpr u32 repeat = 16;
+		constexpr f32 threshold = 0.05f;
+
+		clock::time_point start = clock::now();
+		for (u32 i = 0; i < repeat; i++) {
+			this->a.clear();
+			this->kernel.find(data, threshold, this->a);
+		}
+		this->simd += (clock::now() - start) / repeat;
+
+		start = clock::now();
+		for (u32 i = 0; i < repeat; i++) {
+			this->b.clear();
+			contacts::advanced::alg::find_local_maximas(data, threshold,
+								    std::back_inserter(this->b));
+		}
+		this->scalar += (clock::now() - start) / repeat;
+
+		this->frames++;
+		if (this->a != this->b)
+			this->mismatches++;
+	}
+};
+
+/*
+ * Times the contact assignment of the tracker on random distances, for a few contact counts.
+ */
+static void iptsd_perf_assignment()
+{
+	using clock = std::chrono::steady_clock;
+	constexpr u32 repeat = 10000;
+
+	contacts::Assignment<f64, IPTS_MAX_CONTACTS> assignment {};
+	std::mt19937 rng {42};
+	std::uniform_real_distribution<f64> dist {0, 1};
+
+	for (const u32 n : {2U, 5U, 10U, u32 {IPTS_MAX_CONTACTS}}) {
+		clock::duration total {};
+
+		for (u32 k = 0; k < repeat; k++) {
+			assignment.resize(n, n);
+
+			for (u32 i = 0; i < n; i++) {
+				for (u32 j = 0; j < n; j++)
+					assignment.cost(i, j) = dist(rng);
+			}
+
+			const clock::time_point start = clock::now();
+			assignment.solve();
+			total += clock::now() - start;
+		}
+
+		const auto ns = std::chrono::duration_cast<std::chrono::duration<f64, std::nano>>(total);
+		spdlog::info("Assignment of {:>2} contacts: {:.0f}ns", n, ns.count() / repeat);
+	}
+}
+
+/*
+ * Times the gaussian smoothing of the advanced detector per frame (once on the heatmap, and
+ * twice on the tensor images), with the separable and with the full 5x5 convolution.
+ */
+static void iptsd_perf_convolution()
+{
+	using clock = std::chrono::steady_clock;
+	namespace alg = contacts::advanced::alg;
+
+	constexpr u32 repeat = 1000;
+
+	std::mt19937 rng {42};
+	std::uniform_real_distribution<f32> dist {0, 1};
+
+	const auto kernel = alg::conv::kernels::gaussian<f32, 5, 5>(1.0f);
+
+	// The heatmap of the Surface Pro 7, and two larger ones
+	for (const index2_t size : {index2_t {64, 44}, index2_t {72, 48}, index2_t {128, 88}}) {
+		container::Image<f32> hm {size};
+		container::Image<f32> hm_out {size};
+		container::Image<math::Mat2s<f32>> m2 {size};
+		container::Image<math::Mat2s<f32>> m2_out {size};
+
+		for (index_t i = 0; i < size.span(); i++) {
+			hm[i] = dist(rng);
+			m2[i] = math::Mat2s<f32> {dist(rng), dist(rng), dist(rng)};
+		}
+
+		clock::time_point start = clock::now();
+		for (u32 i = 0; i < repeat; i++) {
+			alg::convolve(hm_out, hm, kernel);
+			alg::convolve(m2_out, m2, kernel);
+			alg::convolve(m2_out, m2, kernel);
+		}
+		const clock::duration separable = (clock::now() - start) / repeat;
+
+		start = clock::now();
+		for (u32 i = 0; i < repeat; i++) {
+			alg::conv::impl::conv_5x5_extend<f32, f32>(hm_out, hm, kernel);
+			alg::conv::impl::conv_5x5_extend<math::Mat2s<f32>, f32>(m2_out, m2, kernel);
+			alg::conv::impl::conv_5x5_extend<math::Mat2s<f32>, f32>(m2_out, m2, kernel);
+		}
+		const clock::duration full = (clock::now() - start) / repeat;
+
+		const auto us = [](clock::duration d) {
+			return std::chrono::duration_cast<std::chrono::duration<f64, std::micro>>(d)
+				.count();
+		};
+
+		spdlog::info("Convolution {}x{}: {:.2f}μs (separable), {:.2f}μs (5x5) per frame",
+			     size.x, size.y, us(separable), us(full));
+	}
+}
+
+/*
+ * Times the structure tensor and ridge stages of the advanced detector, once with interleaved
+ * Image<Mat2s<f32>> tensors and once with planar tensors and the batched eigenvalues.
+ */
+static void iptsd_perf_tensor()
+{
+	using clock = std::chrono::steady_clock;
+	namespace alg = contacts::advanced::alg;
+
+	constexpr u32 repeat = 1000;
+
+	std::mt19937 rng {42};
+	std::uniform_real_distribution<f32> dist {0, 1};
+
+	const auto kernel = alg::conv::kernels::gaussian<f32, 5, 5>(1.0f);
+
+	const auto ridge = [](const math::Mat2s<f32> &h) {
+		const auto [ev1, ev2] = h.eigenvalues();
+		return std::max(ev1, 0.0f) + std::max(ev2, 0.0f);
+	};
+
+	for (const index2_t size : {index2_t {64, 44}, index2_t {72, 48}, index2_t {128, 88}}) {
+		container::Image<f32> pp {size};
+		container::Image<f32> rdg {size};
+
+		for (index_t i = 0; i < size.span(); i++)
+			pp[i] = dist(rng);
+
+		container::Image<math::Mat2s<f32>> st {size};
+		container::Image<math::Mat2s<f32>> hs {size};
+		container::Image<std::array<f32, 2>> stev {size};
+
+		clock::time_point start = clock::now();
+		for (u32 i = 0; i < repeat; i++) {
+			alg::structure_tensor(st, pp);
+			alg::hessian(hs, pp);
+
+			alg::convolve(stev, st, kernel, [](const auto &s) { return s.eigenvalues(); });
+			alg::convolve(rdg, hs, kernel, ridge);
+		}
+		const clock::duration interleaved = (clock::now() - start) / repeat;
+
+		alg::TensorImage<f32> pst {size};
+		alg::TensorImage<f32> phs {size};
+		container::Image<f32> stev1 {size};
+		container::Image<f32> stev2 {size};
+		container::Image<f32> hsev1 {size};
+		container::Image<f32> hsev2 {size};
+
+		start = clock::now();
+		for (u32 i = 0; i < repeat; i++) {
+			alg::structure_tensor_hessian(pst, phs, pp);
+
+			alg::smoothed_eigenvalues(stev1, stev2, pst, kernel);
+			alg::smoothed_eigenvalues(hsev1, hsev2, phs, kernel);
+
+			for (index_t j = 0; j < size.span(); j++)
+				rdg[j] = std::max(hsev1[j], 0.0f) + std::max(hsev2[j], 0.0f);
+		}
+		const clock::duration planar = (clock::now() - start) / repeat;
+
+		const auto us = [](clock::duration d) {
+			return std::chrono::duration_cast<std::chrono::duration<f64, std::micro>>(d)
+				.count();
+		};
+
+		spdlog::info("Tensors {}x{}: {:.2f}μs (planar), {:.2f}μs (interleaved) per frame",
+			     size.x, size.y, us(planar), us(interleaved));
+	}
+}
+
+/*
+ * Runs the dump through one finder with and one without prediction, and compares every
+ * predicted position with the measured position of the same contact one latency later.
+ * All distances are in centimeters.
+ */
+static void iptsd_perf_prediction(const config::Config &config, gsl::span<u8> buffer)
+{
+	struct Sample {
+		bool present = false;
+		math::Vec2<f64> measured {};
+		math::Vec2<f64> predicted {};
+	};
+
+	struct Frame {
+		f64 time = 0;
+		std::array<Sample, IPTS_MAX_CONTACTS> samples {};
+	};
+
+	contacts::Config with = config.contacts();
+	contacts::Config without = with;
+	without.prediction_latency = 0;
+
+	contacts::ContactFinder predicted {with};
+	contacts::ContactFinder measured {without};
+
+	std::vector<Frame> frames {};
+	std::optional<u32> last = std::nullopt;
+
+	ipts::Parser parser {};
+	parser.on_heatmap = [&](const ipts::Heatmap &data) {
+		iptsd_perf_handle_input(predicted, data);
+		iptsd_perf_handle_input(measured, data);
+
+		Frame frame {};
+		frame.time = frames.empty() ? 0 : frames.back().time;
+
+		// The finders can't measure the rate of the timestamps, the replay is too fast
+		if (last.has_value()) {
+			const u32 ticks = data.time.timestamp - *last;
+			frame.time += static_cast<f64>(ticks) / contacts::ContactFinder::ticks_per_second;
+		}
+
+		last = data.time.timestamp;
+
+		// Both finders track the same way, so the contacts have the same indices
+		const gsl::span<const contacts::Contact> a = measured.search();
+		const gsl::span<const contacts::Contact> b = predicted.search();
+
+		for (std::size_t i = 0; i < a.size(); i++) {
+			if (!a[i].active || !a[i].valid)
+				continue;
+
+			Sample &sample = frame.samples[a[i].index];
+			sample.present = true;
+			sample.measured = math::Vec2<f64> {a[i].x * with.width, a[i].y * with.height};
+			sample.predicted = math::Vec2<f64> {b[i].x * with.width, b[i].y * with.height};
+		}
+
+		frames.push_back(frame);
+	};
+
+	gsl::span<u8> reader = buffer;
+	while (reader.size() >= sizeof(std::size_t)) {
+		std::size_t size = 0;
+		std::memcpy(&size, reader.data(), sizeof(size));
+		reader = reader.subspan(sizeof(size));
+
+		if (reader.size() < size)
+			break;
+
+		gsl::span<u8> data = reader.subspan(0, size);
+		reader = reader.subspan(size);
+
+		try {
+			parser.parse(data);
+		} catch (std::exception &e) {
+			spdlog::warn(e.what());
+		}
+	}
+
+	// Replaying is faster than real time, so the host clock is no replacement here
+	if (frames.size() > 1 && frames.back().time == 0) {
+		spdlog::warn("The heatmaps have no timestamps, prediction can't be evaluated");
+		return;
+	}
+
+	const f64 latency = with.prediction_latency / 1000.0;
+
+	u64 count = 0;
+	f64 lag = 0;
+	f64 error = 0;
+	f64 overshoot = 0;
+	f64 overshoot_max = 0;
+
+	for (std::size_t f = 0; f < frames.size(); f++) {
+		for (std::size_t k = 0; k < IPTS_MAX_CONTACTS; k++) {
+			const Sample &sample = frames[f].samples[k];
+			if (!sample.present)
+				continue;
+
+			// Find where the contact was one latency later, without it being lifted in between
+			const f64 target_time = frames[f].time + latency;
+			std::size_t g = f + 1;
+
+			while (g < frames.size() && frames[g].samples[k].present &&
+			       frames[g].time < target_time)
+				g++;
+
+			if (g >= frames.size() || !frames[g].samples[k].present)
+				continue;
+
+			const Frame &before = frames[g - 1];
+			const Frame &after = frames[g];
+
+			const f64 span = after.time - before.time;
+			const f64 t = span > 0 ? (target_time - before.time) / span : 1;
+
+			const math::Vec2<f64> target =
+				before.samples[k].measured +
+				(after.samples[k].measured - before.samples[k].measured) * t;
+
+			const math::Vec2<f64> moved = target - sample.measured;
+			const math::Vec2<f64> miss = sample.predicted - target;
+
+			// The part of the error that goes past the target, in the direction of movement
+			f64 over = miss.norm_l2();
+			if (moved.norm_l2() > 0)
+				over = std::max((miss.x * moved.x + miss.y * moved.y) / moved.norm_l2(), 0.0);
+
+			count++;
+			lag += moved.norm_l2();
+			error += miss.norm_l2();
+			overshoot += over;
+			overshoot_max = std::max(overshoot_max, over);
+		}
+	}
+
+	if (count == 0) {
+		spdlog::info("Prediction: No contacts to evaluate");
+		return;
+	}
+
+	const f64 n = gsl::narrow<f64>(count);
+
+	spdlog::info("Prediction ({:.1f}ms, {} samples): error {:.3f}cm (without: {:.3f}cm), "
+		     "overshoot avg {:.3f}cm, max {:.3f}cm",
+		     with.prediction_latency, count, error / n, lag / n, overshoot / n,
+		     overshoot_max);
+}
+
+/*
+ * Runs the dump through a contact finder that uses f32 and one that uses f64, and reports the
+ * largest difference between their contacts. Positions and sizes are in centimeters.
+ */
+static void iptsd_perf_precision(const config::Config &config, gsl::span<u8> buffer)
+{
+	const contacts::Config cfg = config.contacts();
+
+	contacts::BasicContactFinder<f32> single {cfg};
+	contacts::BasicContactFinder<f64> twice {cfg};
+
+	const f64 diag = std::hypot(cfg.width, cfg.height);
+
+	u64 frames = 0;
+	u64 mismatches = 0;
+	f64 position = 0;
+	f64 major = 0;
+	f64 minor = 0;
+	f64 angle = 0;
+
+	ipts::Parser parser {};
+	parser.on_heatmap = [&](const ipts::Heatmap &data) {
+		const index2_t size {data.dim.width, data.dim.height};
+
+		single.resize(size);
+		twice.resize(size);
+
+		single.load(data.data, data.dim.z_min, data.dim.z_max, data.time.timestamp);
+		twice.load(data.data, data.dim.z_min, data.dim.z_max, data.time.timestamp);
+
+		const gsl::span<const contacts::BasicContact<f32>> a = single.search();
+		const gsl::span<const contacts::BasicContact<f64>> b = twice.search();
+
+		frames++;
+
+		// A different rounding can decide whether a blob is found at all
+		bool mismatch = false;
+
+		for (std::size_t i = 0; i < a.size(); i++) {
+			if (a[i].active != b[i].active || a[i].valid != b[i].valid) {
+				mismatch = true;
+				continue;
+			}
+
+			if (!a[i].active)
+				continue;
+
+			if (a[i].index != b[i].index) {
+				mismatch = true;
+				continue;
+			}
+
+			const f64 dx = (a[i].x - b[i].x) * cfg.width;
+			const f64 dy = (a[i].y - b[i].y) * cfg.height;
+
+			position = std::max(position, std::hypot(dx, dy));
+			major = std::max(major, std::abs(a[i].major - b[i].major) * diag);
+			minor = std::max(minor, std::abs(a[i].minor - b[i].minor) * diag);
+
+			// The angle of a contact that is almost round is meaningless
+			if (b[i].major < b[i].minor * 1.1)
+				continue;
+
+			// The angle of an ellipse is the same after half a turn
+			const f64 da = std::remainder(a[i].angle - b[i].angle, math::num<f64>::pi);
+			angle = std::max(angle, std::abs(da));
+		}
+
+		mismatches += mismatch ? 1 : 0;
+	};
+
+	gsl::span<u8> reader = buffer;
+	while (reader.size() >= sizeof(std::size_t)) {
+		std::size_t size = 0;
+		std::memcpy(&size, reader.data(), sizeof(size));
+		reader = reader.subspan(sizeof(size));
+
+		if (reader.size() < size)
+			break;
+
+		gsl::span<u8> data = reader.subspan(0, size);
+		reader = reader.subspan(size);
+
+		try {
+			parser.parse(data);
+		} catch (std::exception &e) {
+			spdlog::warn(e.what());
+		}
+	}
+
+	spdlog::info("f32 vs f64 ({} heatmaps): position {:.2e}cm, major {:.2e}cm, "
+		     "minor {:.2e}cm, angle {:.2e}° (of oval contacts), {} heatmaps with different "
+		     "contacts",
+		     frames, position, major, minor, angle * 180 / math::num<f64>::pi, mismatches);
+}
+
+/*
+ * Moves two synthetic fingers past each other, and counts how often the tracker swaps their
+ * indices. The fingers start on opposite sides of the screen and move towards each other on
+ * parallel lines, for a few distances between the lines and a few speeds.
+ *
+ * If the lines are close, the fingers merge into one blob for a while. Afterwards, a finger
+ * either gets the index of the other one (swapped), or a new one (renumbered).
+ */
+static void iptsd_perf_crossing(const config::Config &config)
+{
+	constexpr index2_t size {64, 44};
+
+	// About the size of a fingertip, and a typical heatmap rate
+	constexpr f64 radius = 0.4;
+	constexpr f64 rate = 120;
+
+	const contacts::Config cfg = config.contacts();
+	contacts::ContactFinder finder {cfg};
+	finder.resize(size);
+
+	std::vector<u8> heatmap(gsl::narrow<std::size_t>(size.span()));
+
+	// Draws both fingers, positions are in centimeters
+	const auto draw = [&](const std::array<math::Vec2<f64>, 2> &fingers) {
+		const f64 sx = cfg.width / size.x;
+		const f64 sy = cfg.height / size.y;
+
+		for (index_t y = 0; y < size.y; y++) {
+			for (index_t x = 0; x < size.x; x++) {
+				f64 value = 0;
+
+				for (const math::Vec2<f64> &finger : fingers) {
+					const f64 dx = (x + 0.5) * sx - finger.x;
+					const f64 dy = (y + 0.5) * sy - finger.y;
+
+					value = std::max(value, std::exp(-(dx * dx + dy * dy) /
+									 (2 * radius * radius)));
+				}
+
+				// The sensor reports touches as low values
+				heatmap[y * size.x + x] = gsl::narrow_cast<u8>(std::lround(255 - 128 * value));
+			}
+		}
+	};
+
+	const std::array gaps {0.0, 1.0, 2.0, 3.0};
+	const std::array speeds {5.0, 10.0, 20.0, 40.0, 80.0};
+
+	u32 timestamp = 0;
+
+	for (const f64 gap : gaps) {
+		u32 swapped = 0;
+		u32 renumbered = 0;
+		u32 lost = 0;
+
+		for (const f64 speed : speeds) {
+			const math::Vec2<f64> center {cfg.width / 2, cfg.height / 2};
+			const f64 length = cfg.width / 2;
+			const u32 steps = gsl::narrow_cast<u32>(std::ceil(length / speed * rate));
+
+			finder.reset();
+
+			// The index of the contact that belonged to each finger first
+			std::array<std::optional<u32>, 2> index {};
+
+			bool swap = false;
+			bool renumber = false;
+			bool found = true;
+
+			for (u32 i = 0; i <= steps; i++) {
+				const f64 offset = (static_cast<f64>(i) / steps - 0.5) * length;
+
+				const std::array<math::Vec2<f64>, 2> fingers {
+					math::Vec2<f64> {center.x - offset, center.y - gap / 2},
+					math::Vec2<f64> {center.x + offset, center.y + gap / 2},
+				};
+
+				draw(fingers);
+
+				timestamp += gsl::narrow_cast<u32>(
+					contacts::ContactFinder::ticks_per_second / rate);
+				finder.load(heatmap, 0, 255, timestamp);
+
+				const gsl::span<const contacts::Contact> contacts = finder.search();
+
+				// Only look at the fingers while they are clearly apart
+				if ((fingers[0] - fingers[1]).norm_l2() < 6 * radius)
+					continue;
+
+				for (std::size_t f = 0; f < fingers.size(); f++) {
+					std::optional<u32> nearest = std::nullopt;
+					f64 distance = 2 * radius;
+
+					for (const contacts::Contact &contact : contacts) {
+						if (!contact.active)
+							continue;
+
+						const math::Vec2<f64> pos {contact.x * cfg.width,
+									   contact.y * cfg.height};
+						const f64 d = (pos - fingers[f]).norm_l2();
+
+						if (d < distance) {
+							distance = d;
+							nearest = contact.index;
+						}
+					}
+
+					if (!nearest.has_value())
+						found = false;
+					else if (!index[f].has_value())
+						index[f] = nearest;
+					else if (nearest == index[1 - f])
+						swap = true;
+					else if (nearest != index[f])
+						renumber = true;
+				}
+			}
+
+			swapped += swap ? 1 : 0;
+			renumbered += renumber ? 1 : 0;
+			lost += found ? 0 : 1;
+		}
+
+		spdlog::info("Crossing {:.1f}cm apart: {} of {} traces swapped, {} renumbered, "
+			     "{} lost a finger",
+			     gap, swapped, speeds.size(), renumbered, lost);
+	}
+}
+
 static int main(char *dump_file)
 {
     std::filesystem::path path {dump_file};
@@ -49,7 +636,7 @@ static int main(char *dump_file)
 	std::ifstream ifs {};
 	ifs.open(path, std::ios::in | std::ios::binary);
 
-	struct debug::iptsd_dump_header header {};
+	struct ipts::iptsd_dump_header header {};
 	ifs.read(reinterpret_cast<char *>(&header), sizeof(header));
 
 	char has_meta = 0;
@@ -106,7 +693,10 @@ static int main(char *dump_file)
 
 	// Parser is idempotent but ContactFinder is not
 	contacts::ContactFinder finder {config.contacts()};
+	MaximaBenchmark maxima {};
+
 	ipts::Parser parser {};
+	parser.telemetry.enabled = true;
 	parser.on_heatmap = [&](const ipts::Heatmap &data) {
 		iptsd_perf_handle_input(finder, data);
 		// Don't track time for non-heatmap
@@ -159,6 +749,10 @@ static int main(char *dump_file)
 					max = std::max(max, x_ns);
 
 					++count;
+
+					// Only benchmark the maxima kernel once per heatmap
+					if (i == 0)
+						maxima.run(finder.data());
 				}
 			} catch (std::exception &e) {
 				spdlog::warn(e.what());
@@ -182,6 +776,47 @@ static int main(char *dump_file)
 	spdlog::info("Minimum: {:.3f}μs", duration_cast<micros_f64>(min).count());
 	spdlog::info("Maximum: {:.3f}μs", duration_cast<micros_f64>(max).count());
 
+	const contacts::IdleStats &idle = finder.idle_stats();
+	spdlog::info("Idle: {} of {} frames skipped detection ({:.1f}%)", idle.skipped,
+		     idle.frames,
+		     gsl::narrow<f64>(idle.skipped) / gsl::narrow<f64>(std::max<u64>(idle.frames, 1)) *
+			     100);
+
+	if (maxima.frames > 0) {
+		const f64 frames = gsl::narrow<f64>(maxima.frames);
+
+		spdlog::info("Local maxima: {:.3f}μs (simd), {:.3f}μs (scalar), {} mismatches",
+			     duration_cast<micros_f64>(maxima.simd).count() / frames,
+			     duration_cast<micros_f64>(maxima.scalar).count() / frames,
+			     maxima.mismatches);
+	}
+
+	iptsd_perf_assignment();
+	iptsd_perf_convolution();
+	iptsd_perf_tensor();
+	iptsd_perf_crossing(config);
+
+	if (config.contacts_prediction_latency > 0)
+		iptsd_perf_prediction(config, buffer);
+
+	iptsd_perf_precision(config, buffer);
+
+	spdlog::info("Reports:");
+	const auto report = [](const std::string &name, const ipts::ReportStats &stats) {
+		const f64 avg = gsl::narrow<f64>(stats.nanoseconds) / gsl::narrow<f64>(stats.count);
+
+		spdlog::info("{:<25} count={} bytes={} avg={:.0f}ns p50<{}ns p99<{}ns", name,
+			     stats.count, stats.bytes, avg, stats.percentile(0.5),
+			     stats.percentile(0.99));
+	};
+
+	parser.telemetry.for_each([&](u8 type, const ipts::ReportStats &stats) {
+		report(fmt::format("0x{:02X} {}", type, ipts::report_name(type)), stats);
+	});
+
+	if (parser.telemetry.hid_heatmaps.count > 0)
+		report("hid heatmap frames", parser.telemetry.hid_heatmaps);
+
 	return 0;
 }
 
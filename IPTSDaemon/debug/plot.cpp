@@ -4,8 +4,8 @@
 #include <contacts/finder.hpp>
 #include <container/image.hpp>
 #include <gfx/visualization.hpp>
+#include <ipts/dump.hpp>
 #include <ipts/parser.hpp>
-#include "dump.hpp"
 
 #include <algorithm>
 #include <cairomm/cairomm.h>
@@ -30,15 +30,10 @@ static void iptsd_plot_handle_input(const Cairo::RefPtr<Cairo::Context> &cairo,
 	finder.resize(index2_t {data.dim.width, data.dim.height});
 
 	// Normalize and invert the heatmap data.
-	std::transform(data.data.begin(), data.data.end(), finder.data().begin(), [&](f32 v) {
-		const f32 val = (v - static_cast<f32>(data.dim.z_min)) /
-				static_cast<f32>(data.dim.z_max - data.dim.z_min);
-
-		return 1.0f - val;
-	});
+	finder.load(data.data, data.dim.z_min, data.dim.z_max, data.time.timestamp);
 
 	// Search for a contact
-	const std::vector<contacts::Contact> &contacts = finder.search();
+	const gsl::span<const contacts::Contact> contacts = finder.search();
 
 	// Draw the raw heatmap
 	vis.draw_heatmap(cairo, rsize, finder.data());
@@ -55,7 +50,7 @@ static int main(char *dump_file, char *plot_dir)
 	std::ifstream ifs {};
 	ifs.open(path, std::ios::in | std::ios::binary);
 
-	struct debug::iptsd_dump_header header {};
+	struct ipts::iptsd_dump_header header {};
 
 	ifs.read(reinterpret_cast<char *>(&header), sizeof(header));
 
@@ -74,7 +74,7 @@ void Visualization::draw_heatmap(const Cairo::RefPtr<Cairo::Context> &cairo, ind
 }
 
 void Visualization::draw_contacts(const Cairo::RefPtr<Cairo::Context> &cairo, index2_t window,
-				  const std::vector<contacts::Contact> &contacts)
+				  gsl::span<const contacts::Contact> contacts)
 {
 	const f64 diag = std::hypot(window.x, window.y);
 
@@ -11,6 +11,7 @@
 #include <container/image.hpp>
 
 #include <cairomm/cairomm.h>
+#include <gsl/gsl>
 #include <memory>
 #include <vector>
 
@@ -30,7 +31,7 @@ public:
 			  const container::Image<f32> &heatmap);
 
 	void draw_contacts(const Cairo::RefPtr<Cairo::Context> &cairo, index2_t window,
-			   const std::vector<contacts::Contact> &contacts);
+			   gsl::span<const contacts::Contact> contacts);
 };
 
 } /* namespace iptsd::gfx */
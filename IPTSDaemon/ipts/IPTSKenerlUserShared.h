@@ -55,6 +55,9 @@ struct PACKED IPTSHIDReport {
     } report;
 };
 
+// kMethodSendHIDReports takes up to this many reports, packed back to back
+#define IPTS_HID_REPORT_BATCH_MAX  16
+
 struct PACKED IPTSMetadataSize {
     UInt32 rows;
     UInt32 columns;
@@ -96,11 +99,40 @@ struct PACKED IPTSDeviceInfo {
     IPTSDeviceMetaData meta_data;
 };
 
+/*
+ * Instead of a single input buffer that is locked with kMethodToggleProcessingStatus,
+ * newer drivers can map a ring of input slots (memory type kIPTSMemoryInputRing).
+ *
+ * The memory starts with an IPTSInputRingHeader, followed by slot_count slots of
+ * slot_size bytes. Every slot starts with an IPTSInputSlot, followed by the data.
+ * head is only written by the driver, and tail is only written by the daemon.
+ * Both count up and wrap around, the slot they refer to is index % slot_count,
+ * so slot_count has to be a power of two. The ring is empty if head == tail
+ * and full if head - tail == slot_count.
+ */
+enum {
+    kIPTSMemoryInputBuffer,
+    kIPTSMemoryInputRing,
+};
+
+struct IPTSInputRingHeader {
+    UInt32 head;
+    UInt32 tail;
+    UInt32 slot_count;
+    UInt32 slot_size;
+};
+
+struct IPTSInputSlot {
+    UInt32 size;
+    UInt32 reserved;
+};
+
 enum {
     kMethodGetDeviceInfo,
     kMethodReceiveInput,
     kMethodSendHIDReport,
     kMethodToggleProcessingStatus,
+    kMethodSendHIDReports,
     
     kNumberOfMethods
 };
@@ -20,8 +20,15 @@ Device::~Device() {
 }
 
 void Device::reset() {
-    disconnect_from_kernel();
+    {
+        const std::unique_lock<std::shared_mutex> guard {connection};
+        disconnect_from_kernel();
+    }
+    
+    // Reports that are sent in the meantime are dropped
     sleep(3);
+    
+    const std::unique_lock<std::shared_mutex> guard {connection};
     connect_to_kernel();
 }
 
@@ -40,6 +47,8 @@ void Device::connect_to_kernel()
     ret = IOServiceOpen(service, mach_task_self(), 0, &connect);
     if (ret != kIOReturnSuccess)
         throw common::cerror("Failed to establish a connection to the driver");
+    
+    connected = true;
 
     if (initial) {
         IPTSDeviceInfo info;
@@ -56,20 +65,41 @@ void Device::connect_to_kernel()
     }
     
     uint64_t size;
-    ret = IOConnectMapMemory(connect, 0, mach_task_self(), &input_buffer, &size, kIOMapAnywhere | kIOMapInhibitCache);
+    // The ring is synchronized through atomics, so it has to be mapped cacheable
+    ret = IOConnectMapMemory(connect, kIPTSMemoryInputRing, mach_task_self(), &input_buffer, &size, kIOMapAnywhere);
+    if (ret == kIOReturnSuccess) {
+        ring.emplace(reinterpret_cast<void *>(input_buffer), size);
+        return;
+    }
+    
+    ring.reset();
+    ret = IOConnectMapMemory(connect, kIPTSMemoryInputBuffer, mach_task_self(), &input_buffer, &size, kIOMapAnywhere | kIOMapInhibitCache);
     if (ret != kIOReturnSuccess)
         throw common::cerror("Failed to map input buffer into user space");
 }
 
 void Device::disconnect_from_kernel()
 {
-    IOConnectUnmapMemory(connect, 0, mach_task_self(), input_buffer);
+    if (!connected)
+        return;
+    
+    connected = false;
+    IOConnectUnmapMemory(connect, ring.has_value() ? kIPTSMemoryInputRing : kIPTSMemoryInputBuffer, mach_task_self(), input_buffer);
     
     IOServiceClose(connect);
     IOObjectRelease(service);
 }
 
 gsl::span<u8> Device::read() {
+    // Only goes into the kernel if the driver wasn't faster than us
+    if (ring.has_value())
+        return ring->read([this] { wait_for_input(); return true; });
+    
+    uint64_t input_size = wait_for_input();
+    return gsl::span<u8>(reinterpret_cast<u8 *>(input_buffer), input_size);
+}
+
+uint64_t Device::wait_for_input() {
     uint64_t input_size = 0;
     uint32_t cnt = 1;
     kern_return_t ret = IOConnectCallScalarMethod(connect, kMethodReceiveInput, nullptr, 0, &input_size, &cnt);
@@ -78,16 +108,51 @@ gsl::span<u8> Device::read() {
         throw common::cerror("Failed to receive input!");
     }
     
-    return gsl::span<u8>(reinterpret_cast<u8 *>(input_buffer), input_size);
+    return input_size;
 }
 
 void Device::send_hid_report(IPTSHIDReport &report) {
-    kern_return_t ret = IOConnectCallStructMethod(connect, kMethodSendHIDReport, &report, sizeof(IPTSHIDReport), nullptr, nullptr);
-    if (ret != kIOReturnSuccess)
-        throw common::cerror("Failed to send HID report!");
+    if (!reports.push(report)) {
+        flush_hid_reports();
+        reports.push(report);
+    }
+}
+
+void Device::flush_hid_reports() {
+    if (reports.empty())
+        return;
+    
+    send_hid_reports(reports.data());
+    reports.clear();
+}
+
+void Device::send_hid_reports(gsl::span<const IPTSHIDReport> data) {
+    const std::shared_lock<std::shared_mutex> guard {connection};
+    if (!connected)
+        return;
+    
+    // Send everything in a single round trip into the kernel
+    if (batching) {
+        kern_return_t ret = IOConnectCallStructMethod(connect, kMethodSendHIDReports, data.data(), data.size_bytes(), nullptr, nullptr);
+        if (ret == kIOReturnSuccess)
+            return;
+        if (ret != kIOReturnUnsupported && ret != kIOReturnBadArgument)
+            throw common::cerror("Failed to send HID reports!");
+        batching = false;
+    }
+    
+    for (const IPTSHIDReport &report : data) {
+        kern_return_t ret = IOConnectCallStructMethod(connect, kMethodSendHIDReport, &report, sizeof(IPTSHIDReport), nullptr, nullptr);
+        if (ret != kIOReturnSuccess)
+            throw common::cerror("Failed to send HID report!");
+    }
 }
 
 void Device::process_begin() {
+    // A slot of the ring belongs to us until process_end(), no lock needed
+    if (ring.has_value())
+        return;
+    
     if (!processing) {
         processing = true;
         uint64_t status = 1;
@@ -97,7 +162,12 @@ void Device::process_begin() {
     }
 }
 
-void Device::process_end() {
+void Device::release_input() {
+    if (ring.has_value()) {
+        ring->release();
+        return;
+    }
+    
     if (processing) {
         processing = false;
         uint64_t status = 0;
@@ -107,4 +177,9 @@ void Device::process_end() {
     }
 }
 
+void Device::process_end() {
+    release_input();
+    flush_hid_reports();
+}
+
 } // namespace iptsd::ipts
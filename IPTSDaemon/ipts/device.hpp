@@ -9,40 +9,56 @@
 #define device_hpp
 
 #include "IPTSKenerlUserShared.h"
+#include "interface.hpp"
+#include "ring.hpp"
 #include <common/types.hpp>
 
+#include <atomic>
 #include <gsl/gsl>
+#include <mutex>
 #include <optional>
+#include <shared_mutex>
 #include <IOKit/IOKitLib.h>
 
 namespace iptsd::ipts {
 
-class Device {
+class Device : public IDevice {
 public:
     Device();
-    ~Device();
+    ~Device() override;
     
-    void reset();
+    void reset() override;
     
-    gsl::span<u8> read();
+    gsl::span<u8> read() override;
     
-    void send_hid_report(IPTSHIDReport &report);
+    void send_hid_report(IPTSHIDReport &report) override;
+    void send_hid_reports(gsl::span<const IPTSHIDReport> reports) override;
     
-    void process_begin();
-    void process_end();
+    void process_begin() override;
+    void process_end() override;
     
     IOVirtualAddress input_buffer;
-    bool should_reinit {false};
-    
-    i16 vendor_id  {0};
-    i16 product_id {0};
-    std::optional<IPTSDeviceMetaData> meta_data {std::nullopt};
 private:    
     io_connect_t connect;
     io_service_t service;
+    
+    // Reports can be sent from other threads, this keeps reset() from closing the connection under them
+    std::shared_mutex connection;
+    bool connected = false;
+    
     bool processing = false;
     bool initial = true;
     
+    // Set if the driver provides an input ring instead of a single buffer
+    std::optional<InputRingReader> ring;
+    
+    HIDReportQueue reports;
+    // Older drivers don't know kMethodSendHIDReports
+    std::atomic_bool batching = true;
+    
+    void release_input();
+    void flush_hid_reports();
+    uint64_t wait_for_input();
     void connect_to_kernel();
     void disconnect_from_kernel();
 };
@@ -0,0 +1,22 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_IPTS_DUMP_HPP
+#define IPTSD_IPTS_DUMP_HPP
+
+#include <common/types.hpp>
+
+namespace iptsd::ipts {
+
+/*
+ * The header of a file that was recorded by IPTSDump. It is followed by a flag
+ * that tells if the device metadata was stored, the metadata itself, and the
+ * input buffers, each prefixed with its size.
+ */
+struct iptsd_dump_header {
+    i16 vendor;
+    i16 product;
+};
+
+} /* namespace iptsd::ipts */
+
+#endif /* IPTSD_IPTS_DUMP_HPP */
@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_IPTS_INTERFACE_HPP
+#define IPTSD_IPTS_INTERFACE_HPP
+
+#include "IPTSKenerlUserShared.h"
+
+#include <common/types.hpp>
+
+#include <array>
+#include <cstddef>
+#include <gsl/gsl>
+#include <optional>
+
+namespace iptsd::ipts {
+
+/*
+ * Where the input buffers come from, and where the HID reports go to.
+ * This is the IOKit driver in production, but replaying a dump or feeding
+ * buffers from memory allows running the full daemon loop without hardware.
+ */
+class IDevice {
+public:
+	bool should_reinit {false};
+
+	// Set by devices that can run out of data, e.g. when a replay has ended.
+	bool finished {false};
+
+	i16 vendor_id {0};
+	i16 product_id {0};
+	std::optional<IPTSDeviceMetaData> meta_data {std::nullopt};
+
+public:
+	virtual ~IDevice() = default;
+
+	virtual void reset() = 0;
+
+	/*
+	 * Waits for the next input buffer. The returned data is only valid
+	 * until process_end() was called, or the next buffer was read.
+	 */
+	virtual gsl::span<u8> read() = 0;
+
+	/*
+	 * Queues a HID report. All queued reports are sent together when process_end()
+	 * is called, or earlier if the queue is full.
+	 */
+	virtual void send_hid_report(IPTSHIDReport &report) = 0;
+
+	/*
+	 * Sends the reports right away, bypassing the queue.
+	 * Unlike everything else, this may be called from any thread.
+	 */
+	virtual void send_hid_reports(gsl::span<const IPTSHIDReport> reports) = 0;
+
+	virtual void process_begin() = 0;
+
+	// Gives the input buffer back to the driver and sends all queued reports.
+	virtual void process_end() = 0;
+};
+
+/*
+ * The reports that were created while processing one input buffer.
+ */
+class HIDReportQueue {
+private:
+	std::array<IPTSHIDReport, IPTS_HID_REPORT_BATCH_MAX> reports {};
+	std::size_t count = 0;
+
+public:
+	// Returns false if the queue is full and has to be flushed first.
+	bool push(const IPTSHIDReport &report);
+	void clear();
+
+	[[nodiscard]] bool empty() const;
+	[[nodiscard]] gsl::span<const IPTSHIDReport> data() const;
+};
+
+inline bool HIDReportQueue::push(const IPTSHIDReport &report)
+{
+	if (this->count == this->reports.size())
+		return false;
+
+	this->reports[this->count++] = report;
+	return true;
+}
+
+inline void HIDReportQueue::clear()
+{
+	this->count = 0;
+}
+
+inline bool HIDReportQueue::empty() const
+{
+	return this->count == 0;
+}
+
+inline gsl::span<const IPTSHIDReport> HIDReportQueue::data() const
+{
+	return gsl::span<const IPTSHIDReport>(this->reports.data(), this->count);
+}
+
+} /* namespace iptsd::ipts */
+
+#endif /* IPTSD_IPTS_INTERFACE_HPP */
@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "memory.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace iptsd::ipts {
+
+MemoryDevice::MemoryDevice(i16 vendor, i16 product, std::optional<IPTSDeviceMetaData> meta)
+{
+	this->vendor_id = vendor;
+	this->product_id = product;
+	this->meta_data = meta;
+}
+
+void MemoryDevice::push(std::vector<u8> buffer)
+{
+	// The slots of the ring are sized for the buffers that exist when it is created
+	if (this->ring.has_value())
+		throw std::logic_error("Buffers must be pushed before the ring is set up!");
+
+	this->buffers.push_back(std::move(buffer));
+	this->finished = false;
+}
+
+void MemoryDevice::rewind()
+{
+	this->index = 0;
+	this->finished = false;
+
+	if (!this->ring.has_value())
+		return;
+
+	this->ring->release();
+	while (!this->ring->get().empty())
+		this->ring->get().pop();
+}
+
+std::size_t MemoryDevice::size() const
+{
+	return this->buffers.size();
+}
+
+void MemoryDevice::use_ring(u32 slot_count)
+{
+	std::size_t largest = 0;
+	for (const std::vector<u8> &buffer : this->buffers)
+		largest = std::max(largest, buffer.size());
+
+	const u32 slot_size = gsl::narrow<u32>(sizeof(IPTSInputSlot) + largest);
+	const std::size_t bytes = InputRing::bytes(slot_count, slot_size);
+
+	this->ring.reset();
+	this->ring_memory.assign((bytes + sizeof(u64) - 1) / sizeof(u64), 0);
+
+	InputRing::init(this->ring_memory.data(), slot_count, slot_size);
+	this->ring.emplace(this->ring_memory.data(), bytes);
+}
+
+std::vector<u8> *MemoryDevice::next_buffer()
+{
+	if (this->index >= this->buffers.size() && this->loop)
+		this->index = 0;
+
+	if (this->index >= this->buffers.size())
+		return nullptr;
+
+	return &this->buffers[this->index++];
+}
+
+/*
+ * Plays the driver while the reader is waiting for an empty ring. The ring is
+ * filled completely, so the following reads don't have to wait, and the head
+ * and tail keep wrapping around the slots.
+ */
+bool MemoryDevice::produce()
+{
+	InputRing &ring = this->ring->get();
+	bool produced = false;
+
+	while (std::vector<u8> *buffer = this->next_buffer()) {
+		if (!ring.push(*buffer)) {
+			// The ring is full, hand out this buffer next time
+			this->index--;
+			break;
+		}
+
+		produced = true;
+	}
+
+	return produced;
+}
+
+gsl::span<u8> MemoryDevice::read()
+{
+	gsl::span<u8> data {};
+
+	if (this->ring.has_value()) {
+		data = this->ring->read([this] { return this->produce(); });
+		this->finished = this->ring->get().empty();
+	} else if (std::vector<u8> *buffer = this->next_buffer()) {
+		data = gsl::span<u8>(buffer->data(), buffer->size());
+	} else {
+		this->finished = true;
+	}
+
+	if (this->finished)
+		return {};
+
+	this->buffers_read++;
+
+	const std::lock_guard<std::mutex> guard {this->lock};
+	this->last_read = clock::now();
+
+	return data;
+}
+
+void MemoryDevice::send_hid_report(IPTSHIDReport &report)
+{
+	if (!this->reports.push(report)) {
+		this->flush_hid_reports();
+		this->reports.push(report);
+	}
+}
+
+void MemoryDevice::process_end()
+{
+	if (this->ring.has_value())
+		this->ring->release();
+
+	this->flush_hid_reports();
+}
+
+void MemoryDevice::flush_hid_reports()
+{
+	if (this->reports.empty())
+		return;
+
+	this->send_hid_reports(this->reports.data());
+	this->reports.clear();
+}
+
+void MemoryDevice::send_hid_reports(gsl::span<const IPTSHIDReport> reports)
+{
+	const std::lock_guard<std::mutex> guard {this->lock};
+	const clock::duration latency = clock::now() - this->last_read;
+
+	this->submissions++;
+	this->latency_max = std::max(this->latency_max, latency);
+
+	for (const IPTSHIDReport &report : reports) {
+		this->reports_sent++;
+		this->latency_total += latency;
+
+		if (this->on_report)
+			this->on_report(report);
+	}
+}
+
+} /* namespace iptsd::ipts */
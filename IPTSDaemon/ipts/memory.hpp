@@ -0,0 +1,100 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_IPTS_MEMORY_HPP
+#define IPTSD_IPTS_MEMORY_HPP
+
+#include "interface.hpp"
+#include "ring.hpp"
+
+#include <common/types.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <gsl/gsl>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace iptsd::ipts {
+
+/*
+ * Hands out a list of buffers that is kept in memory, and swallows all HID reports.
+ * Every report is timed against the buffer it was created from, so the whole
+ * path from input buffer to HID report can be measured. Reports are batched
+ * the same way as for the real device.
+ *
+ * Optionally, the buffers are fed through an input ring instead of being handed
+ * out directly, so the consumer side of the ring can be used without the driver.
+ */
+class MemoryDevice : public IDevice {
+public:
+	using clock = std::chrono::steady_clock;
+
+	// Start again at the first buffer when the last one was read.
+	bool loop = false;
+
+	// Called with every HID report that is sent to the device.
+	std::function<void(const IPTSHIDReport &)> on_report;
+
+	u64 buffers_read = 0;
+
+	/*
+	 * Reports can be sent from other threads. Hold this lock when reading
+	 * the members below while the device is in use.
+	 */
+	std::mutex lock {};
+
+	u64 reports_sent = 0;
+
+	// How many batches of reports were sent, i.e. round trips into the driver.
+	u64 submissions = 0;
+
+	// Time between reading the newest buffer and sending a report.
+	clock::duration latency_total {};
+	clock::duration latency_max {};
+
+private:
+	std::vector<std::vector<u8>> buffers {};
+	std::size_t index = 0;
+
+	HIDReportQueue reports {};
+	clock::time_point last_read {};
+
+	// u64, so that the ring header is aligned for atomic access
+	std::vector<u64> ring_memory {};
+	std::optional<InputRingReader> ring;
+
+public:
+	MemoryDevice(i16 vendor = 0, i16 product = 0,
+		     std::optional<IPTSDeviceMetaData> meta = std::nullopt);
+
+	void push(std::vector<u8> buffer);
+	void rewind();
+
+	[[nodiscard]] std::size_t size() const;
+
+	/*
+	 * Feeds the buffers through an input ring with the given number of slots.
+	 * The slots are sized for the largest buffer that was pushed so far.
+	 */
+	void use_ring(u32 slot_count);
+
+	void reset() override {};
+
+	gsl::span<u8> read() override;
+	void send_hid_report(IPTSHIDReport &report) override;
+	void send_hid_reports(gsl::span<const IPTSHIDReport> reports) override;
+
+	void process_begin() override {};
+	void process_end() override;
+
+private:
+	[[nodiscard]] std::vector<u8> *next_buffer();
+	bool produce();
+	void flush_hid_reports();
+};
+
+} /* namespace iptsd::ipts */
+
+#endif /* IPTSD_IPTS_MEMORY_HPP */
@@ -6,15 +6,18 @@
 #include "protocol.hpp"
 #include "IPTSKenerlUserShared.h"
 #include "reader.hpp"
+#include "telemetry.hpp"
 
 #include <common/types.hpp>
 
 #include <array>
+#include <bitset>
 #include <cstddef>
 #include <functional>
 #include <gsl/gsl>
 #include <memory>
 #include <optional>
+#include <stdexcept>
 #include <vector>
 
 namespace iptsd::ipts {
@@ -43,11 +46,30 @@ public:
 	struct ipts_dimensions dim {};
 	struct ipts_timestamp time {};
 
-	std::vector<u8> data {};
+	/*
+	 * Points directly into the buffer that was passed to Parser::parse, no copy is made.
+	 * For the daemon, this means it is only valid until Device::process_end() was called.
+	 */
+	gsl::span<const u8> data {};
+};
+
+enum class ParseStatus {
+	OK,
+
+	// The data ended before a header or report was complete.
+	TRUNCATED,
 
-	void resize(u16 size);
+	// A frame header announced a size that is smaller than the header itself.
+	INVALID_SIZE,
+
+	// A DFT window announced more rows than IPTS_DFT_MAX_ROWS.
+	INVALID_DFT_ROWS,
 };
 
+constexpr std::size_t IPTS_PARSE_STATUS_COUNT = 4;
+
+const char *to_string(ParseStatus status);
+
 class DftWindow {
 public:
 	u8 rows = 0;
@@ -60,49 +82,522 @@ public:
 	std::array<struct ipts_pen_dft_window_row, IPTS_DFT_MAX_ROWS> y {};
 };
 
-class Parser {
+/*
+ * A sink receives the data produced by the parser. It may implement any of these functions:
+ *
+ *   void stylus_input(const StylusData &data);
+ *   void heatmap_input(const Heatmap &data);
+ *   void dft_input(const DftWindow &dft, StylusData &stylus);
+ *
+ * Reports that the sink has no function for are skipped without being parsed.
+ * dft_input is responsible for reporting the stylus state it updated, if it needs to.
+ */
+template <class Sink>
+concept StylusSink = requires(Sink &sink, const StylusData &data) { sink.stylus_input(data); };
+
+template <class Sink>
+concept HeatmapSink = requires(Sink &sink, const Heatmap &data) { sink.heatmap_input(data); };
+
+template <class Sink>
+concept DftSink = requires(Sink &sink, const DftWindow &dft, StylusData &stylus) {
+	sink.dft_input(dft, stylus);
+};
+
+/*
+ * The parser itself, calling into a sink that is known at compile time,
+ * so the handlers can be inlined into the parsing loop.
+ */
+template <class Sink> class BasicParser {
 private:
-	std::unique_ptr<Heatmap> heatmap = nullptr;
+	Sink &sink;
+
+	Heatmap heatmap {};
+	bool heatmap_pending = false;
+	u64 heatmap_dropped = 0;
 
 	StylusData stylus {};
 	struct ipts_dimensions dim {};
 	struct ipts_timestamp time {};
 
-	void parse_with_header(gsl::span<u8> &data, std::size_t header);
+	std::array<u64, IPTS_PARSE_STATUS_COUNT> status_count {};
+
+	ParseStatus parse_with_header(gsl::span<u8> &data, std::size_t header);
+
+	ParseStatus parse_frame(Reader &reader);
+	ParseStatus parse_raw(Reader &reader);
+	ParseStatus parse_hid(Reader &reader);
+	ParseStatus parse_reports(Reader &reader);
+
+	ParseStatus parse_stylus_v1(Reader &reader);
+	ParseStatus parse_stylus_v2(Reader &reader);
+
+	ParseStatus parse_dimensions(Reader &reader);
+	ParseStatus parse_timestamp(Reader &reader);
+	ParseStatus parse_heatmap_data(Reader &reader);
+	ParseStatus parse_heatmap_frame(Reader &reader);
+	ParseStatus parse_dft_window(Reader &reader);
+
+public:
+	/*
+	 * If a buffer contains more than one heatmap, only pass the newest one to the sink,
+	 * after the whole buffer was parsed. Stylus data is always passed on immediately.
+	 */
+	bool coalesce_heatmaps = false;
+
+	/*
+	 * Per report type counters, see Telemetry. When heatmaps are coalesced,
+	 * the time of a heatmap report does not include the sink anymore.
+	 */
+	Telemetry telemetry {};
+
+public:
+	BasicParser(Sink &sink) : sink {sink} {};
 
-	void parse_frame(Reader &reader);
-	void parse_raw(Reader &reader);
-	void parse_hid(Reader &reader);
-	void parse_reports(Reader &reader);
+	void parse(gsl::span<u8> &data);
+	template <class T> void parse(gsl::span<u8> &data);
 
-	void parse_stylus_v1(Reader &reader);
-	void parse_stylus_v2(Reader &reader);
+	/*
+	 * Non-throwing variants of parse(). Malformed data is reported through
+	 * the returned status and counted, see count(ParseStatus).
+	 */
+	ParseStatus try_parse(gsl::span<u8> &data);
+	template <class T> ParseStatus try_parse(gsl::span<u8> &data);
 
-	void parse_dimensions(Reader &reader);
-	void parse_timestamp(Reader &reader);
-	void parse_heatmap_data(Reader &reader);
-	void parse_heatmap_frame(Reader &reader);
-	void parse_dft_window(Reader &reader);
+	[[nodiscard]] u64 count(ParseStatus status) const;
+	[[nodiscard]] u64 dropped_heatmaps() const;
+};
 
+/*
+ * Forwards everything to std::function callbacks, which can be changed at runtime.
+ */
+class FunctionSink {
 public:
 	std::function<void(const StylusData &)> on_stylus;
 	std::function<void(const Heatmap &)> on_heatmap;
 	std::function<void(const DftWindow &, StylusData &)> on_dft;
 
-	void parse(gsl::span<u8> &data);
-	template <class T> void parse(gsl::span<u8> &data);
+	void stylus_input(const StylusData &data);
+	void heatmap_input(const Heatmap &data);
+	void dft_input(const DftWindow &dft, StylusData &stylus);
 };
 
-inline void Parser::parse(gsl::span<u8> &data)
+class Parser : public FunctionSink, public BasicParser<FunctionSink> {
+public:
+	Parser() : BasicParser<FunctionSink> {static_cast<FunctionSink &>(*this)} {};
+};
+
+inline void FunctionSink::stylus_input(const StylusData &data)
+{
+	if (this->on_stylus)
+		this->on_stylus(data);
+}
+
+inline void FunctionSink::heatmap_input(const Heatmap &data)
+{
+	if (this->on_heatmap)
+		this->on_heatmap(data);
+}
+
+inline void FunctionSink::dft_input(const DftWindow &dft, StylusData &stylus)
+{
+	if (!this->on_dft)
+		return;
+
+	this->on_dft(dft, stylus);
+
+	if (!this->on_stylus)
+		return;
+
+	this->on_stylus(stylus);
+}
+
+template <class Sink> inline void BasicParser<Sink>::parse(gsl::span<u8> &data)
+{
+	const ParseStatus status = this->try_parse(data);
+
+	if (status != ParseStatus::OK)
+		throw std::runtime_error(to_string(status));
+}
+
+template <class Sink> template <class T> inline void BasicParser<Sink>::parse(gsl::span<u8> &data)
+{
+	const ParseStatus status = this->template try_parse<T>(data);
+
+	if (status != ParseStatus::OK)
+		throw std::runtime_error(to_string(status));
+}
+
+template <class Sink> inline ParseStatus BasicParser<Sink>::try_parse(gsl::span<u8> &data)
+{
+	return this->parse_with_header(data, sizeof(struct ipts_header));
+}
+
+template <class Sink>
+template <class T>
+inline ParseStatus BasicParser<Sink>::try_parse(gsl::span<u8> &data)
+{
+	return this->parse_with_header(data, sizeof(T));
+}
+
+template <class Sink> inline u64 BasicParser<Sink>::count(ParseStatus status) const
+{
+	return this->status_count.at(static_cast<std::size_t>(status));
+}
+
+template <class Sink> inline u64 BasicParser<Sink>::dropped_heatmaps() const
+{
+	return this->heatmap_dropped;
+}
+
+template <class Sink>
+inline ParseStatus BasicParser<Sink>::parse_with_header(gsl::span<u8> &data, std::size_t header)
+{
+	Reader reader(data);
+	ParseStatus status = ParseStatus::TRUNCATED;
+
+	// A heatmap from a previous buffer must never be passed on, the view would be stale.
+	this->heatmap_pending = false;
+
+	if (reader.try_skip(header))
+		status = this->parse_frame(reader);
+
+	this->status_count.at(static_cast<std::size_t>(status))++;
+
+	// Pass on the newest heatmap of the buffer, even if a later part of it was broken.
+	if constexpr (HeatmapSink<Sink>) {
+		if (this->heatmap_pending) {
+			this->heatmap_pending = false;
+			this->sink.heatmap_input(this->heatmap);
+		}
+	}
+
+	return status;
+}
+
+template <class Sink> inline ParseStatus BasicParser<Sink>::parse_frame(Reader &reader)
+{
+	struct ipts_hid_frame header {};
+	if (!reader.try_read(header))
+		return ParseStatus::TRUNCATED;
+
+	if (header.size < sizeof(header))
+		return ParseStatus::INVALID_SIZE;
+
+	std::optional<Reader> sub = reader.try_sub(header.size - sizeof(header));
+	if (!sub.has_value())
+		return ParseStatus::TRUNCATED;
+
+	// Check if we are dealing with GuC based or HID based IPTS
+	switch (header.type) {
+	case IPTS_HID_FRAME_TYPE_RAW:
+		return this->parse_raw(*sub);
+	case IPTS_HID_FRAME_TYPE_HID:
+		return this->parse_hid(*sub);
+	}
+
+	return ParseStatus::OK;
+}
+
+template <class Sink> inline ParseStatus BasicParser<Sink>::parse_raw(Reader &reader)
+{
+	struct ipts_raw_header header {};
+	if (!reader.try_read(header))
+		return ParseStatus::TRUNCATED;
+
+	for (u32 i = 0; i < header.frames; i++) {
+		struct ipts_raw_frame frame {};
+		if (!reader.try_read(frame))
+			return ParseStatus::TRUNCATED;
+
+		std::optional<Reader> sub = reader.try_sub(frame.size);
+		if (!sub.has_value())
+			return ParseStatus::TRUNCATED;
+
+		ParseStatus status = ParseStatus::OK;
+
+		switch (frame.type) {
+		case IPTS_RAW_FRAME_TYPE_STYLUS:
+		case IPTS_RAW_FRAME_TYPE_HEATMAP:
+			status = this->parse_reports(*sub);
+			break;
+		}
+
+		if (status != ParseStatus::OK)
+			return status;
+	}
+
+	return ParseStatus::OK;
+}
+
+template <class Sink> inline ParseStatus BasicParser<Sink>::parse_hid(Reader &reader)
+{
+	while (reader.size() > 0) {
+		struct ipts_hid_frame frame {};
+		if (!reader.try_read(frame))
+			return ParseStatus::TRUNCATED;
+
+		if (frame.size < sizeof(frame))
+			return ParseStatus::INVALID_SIZE;
+
+		std::optional<Reader> sub = reader.try_sub(frame.size - sizeof(frame));
+		if (!sub.has_value())
+			return ParseStatus::TRUNCATED;
+
+		ParseStatus status = ParseStatus::OK;
+
+		switch (frame.type) {
+		case IPTS_HID_FRAME_TYPE_HEATMAP:
+			if constexpr (HeatmapSink<Sink>) {
+				const std::size_t size = sub->size();
+				const bool measure = this->telemetry.enabled;
+				const auto start = measure ? Telemetry::clock::now()
+							   : Telemetry::clock::time_point {};
+
+				status = this->parse_heatmap_frame(*sub);
+
+				if (measure) {
+					const std::size_t header = sizeof(struct ipts_heatmap_header);
+					const std::size_t payload = size > header ? size - header : 0;
+
+					this->telemetry.hid_heatmaps.add(payload,
+									 Telemetry::clock::now() - start);
+				}
+			}
+			break;
+		case IPTS_HID_FRAME_TYPE_REPORTS:
+			// On SP7 we receive the following data about once per second:
+			// 16 00 00 00 00 00 00
+			//   0b 00 00 00 00 ff 00
+			//     74 00 04 00 00 00 00 00
+			// This causes a parse error, because the "0b" should be "0f".
+			// So let's just ignore these packets:
+			if (reader.size() == 4)
+				return ParseStatus::OK;
+
+			status = this->parse_reports(*sub);
+			break;
+		}
+
+		if (status != ParseStatus::OK)
+			return status;
+	}
+
+	return ParseStatus::OK;
+}
+
+template <class Sink> inline ParseStatus BasicParser<Sink>::parse_reports(Reader &reader)
+{
+	while (reader.size() > 0) {
+		struct ipts_report report {};
+		if (!reader.try_read(report))
+			return ParseStatus::TRUNCATED;
+
+		std::optional<Reader> sub = reader.try_sub(report.size);
+		if (!sub.has_value())
+			return ParseStatus::TRUNCATED;
+
+		ParseStatus status = ParseStatus::OK;
+
+		const bool measure = this->telemetry.enabled;
+		const auto start =
+			measure ? Telemetry::clock::now() : Telemetry::clock::time_point {};
+
+		switch (report.type) {
+		case IPTS_REPORT_TYPE_STYLUS_V1:
+			if constexpr (StylusSink<Sink>)
+				status = this->parse_stylus_v1(*sub);
+			break;
+		case IPTS_REPORT_TYPE_STYLUS_V2:
+			if constexpr (StylusSink<Sink>)
+				status = this->parse_stylus_v2(*sub);
+			break;
+		case IPTS_REPORT_TYPE_DIMENSIONS:
+			status = this->parse_dimensions(*sub);
+			break;
+		case IPTS_REPORT_TYPE_TIMESTAMP:
+			status = this->parse_timestamp(*sub);
+			break;
+		case IPTS_REPORT_TYPE_HEATMAP:
+			if constexpr (HeatmapSink<Sink>)
+				status = this->parse_heatmap_data(*sub);
+			break;
+		case IPTS_REPORT_TYPE_PEN_DFT_WINDOW:
+			if constexpr (DftSink<Sink>)
+				status = this->parse_dft_window(*sub);
+			break;
+		}
+
+		if (measure) {
+			ReportStats &stats = this->telemetry.reports[report.type];
+			stats.add(report.size, Telemetry::clock::now() - start);
+		}
+
+		if (status != ParseStatus::OK)
+			return status;
+	}
+
+	return ParseStatus::OK;
+}
+
+template <class Sink> inline ParseStatus BasicParser<Sink>::parse_stylus_v1(Reader &reader)
+{
+	struct ipts_stylus_report stylus_report {};
+	if (!reader.try_read(stylus_report))
+		return ParseStatus::TRUNCATED;
+
+	this->stylus.serial = stylus_report.serial;
+
+	for (u8 i = 0; i < stylus_report.elements; i++) {
+		struct ipts_stylus_data_v1 data {};
+		if (!reader.try_read(data))
+			return ParseStatus::TRUNCATED;
+
+		const std::bitset<8> mode(data.mode);
+		this->stylus.proximity = mode[IPTS_STYLUS_REPORT_MODE_BIT_PROXIMITY];
+		this->stylus.contact = mode[IPTS_STYLUS_REPORT_MODE_BIT_CONTACT];
+		this->stylus.button = mode[IPTS_STYLUS_REPORT_MODE_BIT_BUTTON];
+		this->stylus.rubber = mode[IPTS_STYLUS_REPORT_MODE_BIT_RUBBER];
+
+		this->stylus.x = data.x;
+		this->stylus.y = data.y;
+		this->stylus.pressure = data.pressure * 4;
+		this->stylus.azimuth = 0;
+		this->stylus.altitude = 0;
+		this->stylus.timestamp = 0;
+
+		if constexpr (StylusSink<Sink>)
+			this->sink.stylus_input(this->stylus);
+	}
+
+	return ParseStatus::OK;
+}
+
+template <class Sink> inline ParseStatus BasicParser<Sink>::parse_stylus_v2(Reader &reader)
+{
+	struct ipts_stylus_report stylus_report {};
+	if (!reader.try_read(stylus_report))
+		return ParseStatus::TRUNCATED;
+
+	this->stylus.serial = stylus_report.serial;
+
+	for (u8 i = 0; i < stylus_report.elements; i++) {
+		struct ipts_stylus_data_v2 data {};
+		if (!reader.try_read(data))
+			return ParseStatus::TRUNCATED;
+
+		const std::bitset<16> mode(data.mode);
+		this->stylus.proximity = mode[IPTS_STYLUS_REPORT_MODE_BIT_PROXIMITY];
+		this->stylus.contact = mode[IPTS_STYLUS_REPORT_MODE_BIT_CONTACT];
+		this->stylus.button = mode[IPTS_STYLUS_REPORT_MODE_BIT_BUTTON];
+		this->stylus.rubber = mode[IPTS_STYLUS_REPORT_MODE_BIT_RUBBER];
+
+		this->stylus.x = data.x;
+		this->stylus.y = data.y;
+		this->stylus.pressure = data.pressure;
+		this->stylus.azimuth = data.azimuth;
+		this->stylus.altitude = data.altitude;
+		this->stylus.timestamp = data.timestamp;
+
+		if constexpr (StylusSink<Sink>)
+			this->sink.stylus_input(this->stylus);
+	}
+
+	return ParseStatus::OK;
+}
+
+template <class Sink> inline ParseStatus BasicParser<Sink>::parse_dimensions(Reader &reader)
+{
+	if (!reader.try_read(this->dim))
+		return ParseStatus::TRUNCATED;
+
+	// On newer devices, z_max may be 0, lets use a sane value instead.
+	if (this->dim.z_max == 0)
+		this->dim.z_max = 255;
+
+	return ParseStatus::OK;
+}
+
+template <class Sink> inline ParseStatus BasicParser<Sink>::parse_timestamp(Reader &reader)
+{
+	if (!reader.try_read(this->time))
+		return ParseStatus::TRUNCATED;
+
+	return ParseStatus::OK;
+}
+
+template <class Sink> inline ParseStatus BasicParser<Sink>::parse_heatmap_data(Reader &reader)
 {
-	this->parse_with_header(data, sizeof(struct ipts_header));
+	const std::optional<gsl::span<const u8>> data =
+		reader.try_view(this->dim.width * this->dim.height);
+
+	if (!data.has_value())
+		return ParseStatus::TRUNCATED;
+
+	this->heatmap.data = *data;
+	this->heatmap.dim = this->dim;
+	this->heatmap.time = this->time;
+
+	if (!this->coalesce_heatmaps) {
+		this->sink.heatmap_input(this->heatmap);
+		return ParseStatus::OK;
+	}
+
+	// Delay the heatmap until the whole buffer was parsed. If a newer one
+	// shows up in the meantime, this one is stale and gets dropped.
+	if (this->heatmap_pending)
+		this->heatmap_dropped++;
+
+	this->heatmap_pending = true;
+	return ParseStatus::OK;
 }
 
-template <class T> inline void Parser::parse(gsl::span<u8> &data)
+template <class Sink> inline ParseStatus BasicParser<Sink>::parse_heatmap_frame(Reader &reader)
 {
-	this->parse_with_header(data, sizeof(T));
+	struct ipts_heatmap_header header {};
+	if (!reader.try_read(header))
+		return ParseStatus::TRUNCATED;
+
+	std::optional<Reader> sub = reader.try_sub(header.size);
+	if (!sub.has_value())
+		return ParseStatus::TRUNCATED;
+
+	return this->parse_heatmap_data(*sub);
 }
 
+template <class Sink> inline ParseStatus BasicParser<Sink>::parse_dft_window(Reader &reader)
+{
+	DftWindow dft {};
+
+	struct ipts_pen_dft_window window {};
+	if (!reader.try_read(window))
+		return ParseStatus::TRUNCATED;
+
+	if (window.num_rows > IPTS_DFT_MAX_ROWS)
+		return ParseStatus::INVALID_DFT_ROWS;
+
+	for (int i = 0; i < window.num_rows; i++) {
+		if (!reader.try_read(dft.x[i]))
+			return ParseStatus::TRUNCATED;
+	}
+
+	for (int i = 0; i < window.num_rows; i++) {
+		if (!reader.try_read(dft.y[i]))
+			return ParseStatus::TRUNCATED;
+	}
+
+	dft.rows = window.num_rows;
+	dft.type = window.data_type;
+
+	dft.dim = this->dim;
+	dft.time = this->time;
+
+	this->sink.dft_input(dft, this->stylus);
+	return ParseStatus::OK;
+}
+
+// The std::function based parser is compiled once in parser.cpp
+extern template class BasicParser<FunctionSink>;
+
 } /* namespace iptsd::ipts */
 
 #endif /* IPTSD_IPTS_PARSER_HPP */
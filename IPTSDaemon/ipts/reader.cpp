@@ -8,9 +8,46 @@ namespace iptsd::ipts {
 
 void Reader::read(const gsl::span<u8> dest)
 {
-	if (dest.size() > this->size())
+	if (!this->try_read(dest))
+		throw std::runtime_error("Tried to read more data than available!");
+}
+
+void Reader::skip(const size_t size)
+{
+	if (!this->try_skip(size))
+		throw std::runtime_error("Tried to read more data than available!");
+}
+
+std::size_t Reader::size()
+{
+	return this->data.size() - this->index;
+}
+
+Reader Reader::sub(std::size_t size)
+{
+	std::optional<Reader> sub = this->try_sub(size);
+
+	if (!sub.has_value())
+		throw std::runtime_error("Tried to read more data than available!");
+
+	return *sub;
+}
+
+gsl::span<const u8> Reader::view(std::size_t size)
+{
+	const std::optional<gsl::span<const u8>> view = this->try_view(size);
+
+	if (!view.has_value())
 		throw std::runtime_error("Tried to read more data than available!");
 
+	return *view;
+}
+
+bool Reader::try_read(const gsl::span<u8> dest)
+{
+	if (dest.size() > this->size())
+		return false;
+
 	auto begin = this->data.begin();
 	std::advance(begin, this->index);
 
@@ -19,30 +56,39 @@ void Reader::read(const gsl::span<u8> dest)
 
 	std::copy(begin, end, dest.begin());
 	this->index += dest.size();
+
+	return true;
 }
 
-void Reader::skip(const size_t size)
+bool Reader::try_skip(const size_t size)
 {
 	if (size > this->size())
-		throw std::runtime_error("Tried to read more data than available!");
+		return false;
 
 	this->index += size;
+	return true;
 }
 
-std::size_t Reader::size()
+std::optional<Reader> Reader::try_sub(std::size_t size)
 {
-	return this->data.size() - this->index;
+	if (size > this->size())
+		return std::nullopt;
+
+	const gsl::span<u8> sub = this->data.subspan(this->index, size);
+	this->index += size;
+
+	return Reader {sub};
 }
 
-Reader Reader::sub(std::size_t size)
+std::optional<gsl::span<const u8>> Reader::try_view(std::size_t size)
 {
 	if (size > this->size())
-		throw std::runtime_error("Tried to read more data than available!");
+		return std::nullopt;
 
-	const gsl::span<u8> sub = this->data.subspan(this->index, size);
-	this->skip(size);
+	const gsl::span<const u8> view = this->data.subspan(this->index, size);
+	this->index += size;
 
-	return Reader {sub};
+	return view;
 }
 
 } // namespace iptsd::ipts
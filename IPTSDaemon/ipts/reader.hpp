@@ -9,6 +9,7 @@
 #include <functional>
 #include <gsl/gsl>
 #include <memory>
+#include <optional>
 #include <vector>
 
 namespace iptsd::ipts {
@@ -25,8 +26,20 @@ public:
 	void skip(const size_t size);
 	std::size_t size();
 	Reader sub(std::size_t size);
+	gsl::span<const u8> view(std::size_t size);
 
 	template <class T> T read();
+
+	/*
+	 * Non-throwing variants of the functions above.
+	 * If not enough data is available, they fail without advancing the reader.
+	 */
+	[[nodiscard]] bool try_read(const gsl::span<u8> dest);
+	[[nodiscard]] bool try_skip(const size_t size);
+	[[nodiscard]] std::optional<Reader> try_sub(std::size_t size);
+	[[nodiscard]] std::optional<gsl::span<const u8>> try_view(std::size_t size);
+
+	template <class T> [[nodiscard]] bool try_read(T &value);
 };
 
 template <class T> inline T Reader::read()
@@ -40,6 +53,12 @@ template <class T> inline T Reader::read()
 	return value;
 }
 
+template <class T> inline bool Reader::try_read(T &value)
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+	return this->try_read(gsl::span(reinterpret_cast<u8 *>(&value), sizeof(value)));
+}
+
 } /* namespace iptsd::ipts */
 
 #endif /* IPTSD_IPTS_READER_HPP */
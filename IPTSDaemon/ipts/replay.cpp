@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "replay.hpp"
+
+#include "dump.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <ios>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+namespace iptsd::ipts {
+
+ReplayDevice::ReplayDevice(const std::filesystem::path &path, clock::duration interval)
+	: interval {interval}
+{
+	std::ifstream ifs {};
+	ifs.exceptions(std::ios::badbit | std::ios::failbit);
+	ifs.open(path, std::ios::in | std::ios::binary);
+
+	struct iptsd_dump_header header {};
+	ifs.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+	char has_meta = 0;
+	ifs.read(&has_meta, sizeof(has_meta));
+
+	if (has_meta) {
+		IPTSDeviceMetaData meta {};
+		ifs.read(reinterpret_cast<char *>(&meta), sizeof(meta));
+		this->meta_data = meta;
+	}
+
+	this->vendor_id = header.vendor;
+	this->product_id = header.product;
+
+	// Every buffer is prefixed with its size. A truncated buffer at the end is ignored.
+	ifs.exceptions(std::ios::badbit);
+
+	while (true) {
+		ssize_t size = 0;
+		if (!ifs.read(reinterpret_cast<char *>(&size), sizeof(size)) || size < 0)
+			break;
+
+		std::vector<u8> buffer(static_cast<std::size_t>(size));
+		if (!ifs.read(reinterpret_cast<char *>(buffer.data()), size))
+			break;
+
+		this->push(std::move(buffer));
+	}
+}
+
+gsl::span<u8> ReplayDevice::read()
+{
+	if (this->interval > clock::duration::zero()) {
+		std::this_thread::sleep_until(this->next);
+		this->next = std::max(this->next, clock::now()) + this->interval;
+	}
+
+	return MemoryDevice::read();
+}
+
+} /* namespace iptsd::ipts */
@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_IPTS_REPLAY_HPP
+#define IPTSD_IPTS_REPLAY_HPP
+
+#include "memory.hpp"
+
+#include <common/types.hpp>
+
+#include <filesystem>
+#include <gsl/gsl>
+
+namespace iptsd::ipts {
+
+/*
+ * Replays a file that was recorded by IPTSDump.
+ *
+ * Dumps don't store when a buffer was received, so the buffers are handed out
+ * at a fixed interval instead. An interval of zero replays as fast as possible.
+ */
+class ReplayDevice : public MemoryDevice {
+private:
+	clock::duration interval;
+	clock::time_point next {};
+
+public:
+	ReplayDevice(const std::filesystem::path &path, clock::duration interval = {});
+
+	gsl::span<u8> read() override;
+};
+
+} /* namespace iptsd::ipts */
+
+#endif /* IPTSD_IPTS_REPLAY_HPP */
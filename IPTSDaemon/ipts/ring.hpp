@@ -0,0 +1,202 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_IPTS_RING_HPP
+#define IPTSD_IPTS_RING_HPP
+
+#include "IPTSKenerlUserShared.h"
+
+#include <common/types.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <gsl/gsl>
+#include <stdexcept>
+
+namespace iptsd::ipts {
+
+/*
+ * Access to the input ring that is shared with the driver, see IPTSInputRingHeader.
+ * The driver produces into the ring, the daemon is the consumer and only uses
+ * empty(), front() and pop(). init() and push() are the producer side, which is
+ * used to feed recorded buffers through a ring without the driver.
+ */
+class InputRing {
+private:
+	IPTSInputRingHeader *header;
+	u8 *slots;
+
+	// Copied once, so that the layout can't change behind our back.
+	u32 slot_count;
+	u32 slot_size;
+
+public:
+	InputRing(void *memory, std::size_t size);
+
+	// Sets up an empty ring in the given memory.
+	static void init(void *memory, u32 slot_count, u32 slot_size);
+	static std::size_t bytes(u32 slot_count, u32 slot_size);
+
+	[[nodiscard]] u32 size() const;
+	[[nodiscard]] bool empty() const;
+
+	/*
+	 * The data in the oldest slot. The driver won't touch it until pop() is called.
+	 * Must only be called if the ring is not empty.
+	 */
+	[[nodiscard]] gsl::span<u8> front() const;
+	void pop();
+
+	// Returns false if the ring is full, or if the data doesn't fit into a slot.
+	bool push(gsl::span<const u8> data);
+
+private:
+	[[nodiscard]] u8 *slot(u32 index) const;
+};
+
+inline InputRing::InputRing(void *memory, std::size_t size)
+	: header {reinterpret_cast<IPTSInputRingHeader *>(memory)},
+	  slots {reinterpret_cast<u8 *>(memory) + sizeof(IPTSInputRingHeader)}
+{
+	if (size < sizeof(IPTSInputRingHeader))
+		throw std::runtime_error("Input ring is too small!");
+
+	this->slot_count = this->header->slot_count;
+	this->slot_size = this->header->slot_size;
+
+	if (!std::has_single_bit(this->slot_count) || this->slot_size <= sizeof(IPTSInputSlot))
+		throw std::runtime_error("Input ring has an invalid layout!");
+
+	if (size < InputRing::bytes(this->slot_count, this->slot_size))
+		throw std::runtime_error("Input ring is too small!");
+}
+
+inline void InputRing::init(void *memory, u32 slot_count, u32 slot_size)
+{
+	std::memset(memory, 0, InputRing::bytes(slot_count, slot_size));
+
+	auto *header = reinterpret_cast<IPTSInputRingHeader *>(memory);
+	header->slot_count = slot_count;
+	header->slot_size = slot_size;
+}
+
+inline std::size_t InputRing::bytes(u32 slot_count, u32 slot_size)
+{
+	return sizeof(IPTSInputRingHeader) + std::size_t {slot_count} * slot_size;
+}
+
+inline u32 InputRing::size() const
+{
+	const u32 head = std::atomic_ref<u32> {this->header->head}.load(std::memory_order_acquire);
+	const u32 tail = std::atomic_ref<u32> {this->header->tail}.load(std::memory_order_acquire);
+
+	return head - tail;
+}
+
+inline bool InputRing::empty() const
+{
+	return this->size() == 0;
+}
+
+inline gsl::span<u8> InputRing::front() const
+{
+	const u32 tail = std::atomic_ref<u32> {this->header->tail}.load(std::memory_order_relaxed);
+	u8 *slot = this->slot(tail);
+
+	IPTSInputSlot info {};
+	std::memcpy(&info, slot, sizeof(info));
+
+	// Never trust the size that was written by the other side
+	const std::size_t size =
+		std::min<std::size_t>(info.size, this->slot_size - sizeof(IPTSInputSlot));
+
+	return gsl::span<u8>(slot + sizeof(IPTSInputSlot), size);
+}
+
+inline void InputRing::pop()
+{
+	std::atomic_ref<u32> tail {this->header->tail};
+	tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+inline bool InputRing::push(gsl::span<const u8> data)
+{
+	if (data.size() > this->slot_size - sizeof(IPTSInputSlot))
+		return false;
+
+	if (this->size() == this->slot_count)
+		return false;
+
+	std::atomic_ref<u32> head {this->header->head};
+	const u32 index = head.load(std::memory_order_relaxed);
+	u8 *slot = this->slot(index);
+
+	IPTSInputSlot info {};
+	info.size = static_cast<u32>(data.size());
+
+	std::memcpy(slot, &info, sizeof(info));
+	std::memcpy(slot + sizeof(IPTSInputSlot), data.data(), data.size());
+
+	head.store(index + 1, std::memory_order_release);
+	return true;
+}
+
+inline u8 *InputRing::slot(u32 index) const
+{
+	const u32 i = index & (this->slot_count - 1);
+	return this->slots + std::size_t {i} * this->slot_size;
+}
+
+/*
+ * The consumer side of an input ring, as used by the devices. The slot that was
+ * returned by read() belongs to the reader until release() is called, or the next
+ * slot is read.
+ */
+class InputRingReader {
+private:
+	InputRing ring;
+	bool holding = false;
+
+public:
+	InputRingReader(void *memory, std::size_t size) : ring {memory, size} {};
+
+	/*
+	 * Returns the oldest slot. While the ring is empty, wait() is called to block until
+	 * the producer was able to add something. If it returns false, the read is aborted
+	 * and an empty span is returned.
+	 */
+	template <class Wait>
+	gsl::span<u8> read(Wait &&wait)
+	{
+		this->release();
+
+		// No need to wait if the producer was faster than us
+		while (this->ring.empty()) {
+			if (!wait())
+				return {};
+		}
+
+		this->holding = true;
+		return this->ring.front();
+	}
+
+	void release()
+	{
+		if (!this->holding)
+			return;
+
+		this->holding = false;
+		this->ring.pop();
+	}
+
+	[[nodiscard]] InputRing &get()
+	{
+		return this->ring;
+	}
+};
+
+} /* namespace iptsd::ipts */
+
+#endif /* IPTSD_IPTS_RING_HPP */
@@ -0,0 +1,147 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_IPTS_TELEMETRY_HPP
+#define IPTSD_IPTS_TELEMETRY_HPP
+
+#include "protocol.hpp"
+
+#include <common/types.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <chrono>
+#include <cstddef>
+
+namespace iptsd::ipts {
+
+constexpr std::size_t IPTS_TELEMETRY_BUCKETS = 32;
+
+class ReportStats {
+public:
+	u64 count = 0;
+
+	// The sum of the payload sizes, excluding the report header.
+	u64 bytes = 0;
+
+	// The time spent on the report, including the sink that received its data.
+	u64 nanoseconds = 0;
+
+	// Bucket i counts reports that took less than 2^i nanoseconds.
+	std::array<u64, IPTS_TELEMETRY_BUCKETS> histogram {};
+
+public:
+	void add(std::size_t size, std::chrono::nanoseconds time);
+
+	// The upper bound of the histogram bucket that contains the given percentile.
+	[[nodiscard]] u64 percentile(f64 p) const;
+};
+
+/*
+ * Counts how many reports of each type the parser has seen, and how expensive they were.
+ * This is disabled by default, because reading the clock for every report is not free.
+ */
+class Telemetry {
+public:
+	using clock = std::chrono::steady_clock;
+
+	bool enabled = false;
+	std::array<ReportStats, UINT8_MAX + 1> reports {};
+
+	// Heatmaps from HID frames, which are not wrapped in a report. Only the heatmap data is counted.
+	ReportStats hid_heatmaps {};
+
+public:
+	void reset();
+
+	// Calls fn(type, stats) for every report type that was seen at least once.
+	template <class F> void for_each(F fn) const;
+};
+
+inline void ReportStats::add(std::size_t size, std::chrono::nanoseconds time)
+{
+	const u64 ns = static_cast<u64>(std::max<i64>(time.count(), 0));
+	const std::size_t bucket =
+		std::min<std::size_t>(std::bit_width(ns), IPTS_TELEMETRY_BUCKETS - 1);
+
+	this->count++;
+	this->bytes += size;
+	this->nanoseconds += ns;
+	this->histogram[bucket]++;
+}
+
+inline u64 ReportStats::percentile(f64 p) const
+{
+	const auto target = static_cast<u64>(std::ceil(p * static_cast<f64>(this->count)));
+	u64 sum = 0;
+
+	for (std::size_t i = 0; i < this->histogram.size(); i++) {
+		sum += this->histogram[i];
+
+		if (sum >= target)
+			return u64 {1} << i;
+	}
+
+	return u64 {1} << (IPTS_TELEMETRY_BUCKETS - 1);
+}
+
+inline void Telemetry::reset()
+{
+	std::fill(this->reports.begin(), this->reports.end(), ReportStats {});
+	this->hid_heatmaps = ReportStats {};
+}
+
+template <class F> inline void Telemetry::for_each(F fn) const
+{
+	for (std::size_t i = 0; i < this->reports.size(); i++) {
+		if (this->reports[i].count > 0)
+			fn(static_cast<u8>(i), this->reports[i]);
+	}
+}
+
+inline const char *report_name(u8 type)
+{
+	switch (type) {
+	case IPTS_REPORT_TYPE_TIMESTAMP:
+		return "timestamp";
+	case IPTS_REPORT_TYPE_DIMENSIONS:
+		return "dimensions";
+	case IPTS_REPORT_TYPE_HEATMAP:
+		return "heatmap";
+	case IPTS_REPORT_TYPE_STYLUS_V1:
+		return "stylus v1";
+	case IPTS_REPORT_TYPE_STYLUS_V2:
+		return "stylus v2";
+	case IPTS_REPORT_TYPE_FREQUENCY_NOISE:
+		return "frequency noise";
+	case IPTS_REPORT_TYPE_PEN_GENERAL:
+		return "pen general";
+	case IPTS_REPORT_TYPE_PEN_JNR_OUTPUT:
+		return "pen jnr output";
+	case IPTS_REPORT_TYPE_PEN_NOISE_METRICS_OUTPUT:
+		return "pen noise metrics";
+	case IPTS_REPORT_TYPE_PEN_DATA_SELECTION:
+		return "pen data selection";
+	case IPTS_REPORT_TYPE_PEN_MAGNITUDE:
+		return "pen magnitude";
+	case IPTS_REPORT_TYPE_PEN_DFT_WINDOW:
+		return "pen dft window";
+	case IPTS_REPORT_TYPE_PEN_MULTIPLE_REGION:
+		return "pen multiple region";
+	case IPTS_REPORT_TYPE_PEN_TOUCHED_ANTENNAS:
+		return "pen touched antennas";
+	case IPTS_REPORT_TYPE_PEN_METADATA:
+		return "pen metadata";
+	case IPTS_REPORT_TYPE_PEN_DETECTION:
+		return "pen detection";
+	case IPTS_REPORT_TYPE_PEN_LIFT:
+		return "pen lift";
+	default:
+		return "unknown";
+	}
+}
+
+} /* namespace iptsd::ipts */
+
+#endif /* IPTSD_IPTS_TELEMETRY_HPP */
@@ -7,6 +7,9 @@
 #include "num.hpp"
 #include "vec6.hpp"
 
+#include <cmath>
+#include <limits>
+
 namespace iptsd::math {
 
 /**
@@ -221,6 +224,123 @@ template <class T> auto ge_solve(Mat6<T> a, Vec6<T> b, Vec6<T> &x, T eps = num<T
 	return true;
 }
 
+/**
+ * ldlt_solve() - Solve a symmetric system of linear equations via a LDL^T-decomposition.
+ * @a:   The symmetric system matrix A. Only its lower triangle is read.
+ * @b:   The right-hand-side vector b.
+ * @x:   The vector to solve for.
+ * @eps: Lower bound for the diagonal entries of D.
+ *
+ * Factorizes A = LDL^T, with L being a lower unit triangular matrix and D being a diagonal
+ * matrix, and then solves Ly = b, Dz = y and L^Tx = z. The decomposition does not pivot and
+ * therefore only works for positive definite matrices. If any entry of D is not larger than eps
+ * or vanishes compared to the corresponding diagonal entry of A, false is returned and x is
+ * left untouched. Use ge_solve() for those systems.
+ */
+template <class T>
+auto ldlt_solve(Mat6<T> const &a, Vec6<T> const &b, Vec6<T> &x, T eps = num<T>::eps) -> bool
+{
+	auto const pivot = [&](T d, T ajj) -> bool {
+		return d > eps && d > ajj * std::numeric_limits<T>::epsilon();
+	};
+
+	// step 1: decomposition, u[i, j] = L[i, j] * D[j]
+	T const d0 = a[{0, 0}];
+	if (!pivot(d0, a[{0, 0}])) {
+		return false;
+	}
+
+	T const u10 = a[{1, 0}];
+	T const u20 = a[{2, 0}];
+	T const u30 = a[{3, 0}];
+	T const u40 = a[{4, 0}];
+	T const u50 = a[{5, 0}];
+
+	T const r0 = num<T>::one / d0;
+	T const l10 = u10 * r0;
+	T const l20 = u20 * r0;
+	T const l30 = u30 * r0;
+	T const l40 = u40 * r0;
+	T const l50 = u50 * r0;
+
+	T const d1 = a[{1, 1}] - u10 * l10;
+	if (!pivot(d1, a[{1, 1}])) {
+		return false;
+	}
+
+	T const u21 = a[{2, 1}] - u20 * l10;
+	T const u31 = a[{3, 1}] - u30 * l10;
+	T const u41 = a[{4, 1}] - u40 * l10;
+	T const u51 = a[{5, 1}] - u50 * l10;
+
+	T const r1 = num<T>::one / d1;
+	T const l21 = u21 * r1;
+	T const l31 = u31 * r1;
+	T const l41 = u41 * r1;
+	T const l51 = u51 * r1;
+
+	T const d2 = a[{2, 2}] - u20 * l20 - u21 * l21;
+	if (!pivot(d2, a[{2, 2}])) {
+		return false;
+	}
+
+	T const u32 = a[{3, 2}] - u30 * l20 - u31 * l21;
+	T const u42 = a[{4, 2}] - u40 * l20 - u41 * l21;
+	T const u52 = a[{5, 2}] - u50 * l20 - u51 * l21;
+
+	T const r2 = num<T>::one / d2;
+	T const l32 = u32 * r2;
+	T const l42 = u42 * r2;
+	T const l52 = u52 * r2;
+
+	T const d3 = a[{3, 3}] - u30 * l30 - u31 * l31 - u32 * l32;
+	if (!pivot(d3, a[{3, 3}])) {
+		return false;
+	}
+
+	T const u43 = a[{4, 3}] - u40 * l30 - u41 * l31 - u42 * l32;
+	T const u53 = a[{5, 3}] - u50 * l30 - u51 * l31 - u52 * l32;
+
+	T const r3 = num<T>::one / d3;
+	T const l43 = u43 * r3;
+	T const l53 = u53 * r3;
+
+	T const d4 = a[{4, 4}] - u40 * l40 - u41 * l41 - u42 * l42 - u43 * l43;
+	if (!pivot(d4, a[{4, 4}])) {
+		return false;
+	}
+
+	T const u54 = a[{5, 4}] - u50 * l40 - u51 * l41 - u52 * l42 - u53 * l43;
+
+	T const r4 = num<T>::one / d4;
+	T const l54 = u54 * r4;
+
+	T const d5 = a[{5, 5}] - u50 * l50 - u51 * l51 - u52 * l52 - u53 * l53 - u54 * l54;
+	if (!pivot(d5, a[{5, 5}])) {
+		return false;
+	}
+
+	T const r5 = num<T>::one / d5;
+
+	// step 2: solve Ly = b for y (forward substitution)
+	T const y0 = b[0];
+	T const y1 = b[1] - l10 * y0;
+	T const y2 = b[2] - l20 * y0 - l21 * y1;
+	T const y3 = b[3] - l30 * y0 - l31 * y1 - l32 * y2;
+	T const y4 = b[4] - l40 * y0 - l41 * y1 - l42 * y2 - l43 * y3;
+	T const y5 = b[5] - l50 * y0 - l51 * y1 - l52 * y2 - l53 * y3 - l54 * y4;
+
+	// step 3: solve L^Tx = D^-1 y for x (backward substitution)
+	x[5] = y5 * r5;
+	x[4] = y4 * r4 - l54 * x[5];
+	x[3] = y3 * r3 - l43 * x[4] - l53 * x[5];
+	x[2] = y2 * r2 - l32 * x[3] - l42 * x[4] - l52 * x[5];
+	x[1] = y1 * r1 - l21 * x[2] - l31 * x[3] - l41 * x[4] - l51 * x[5];
+	x[0] = y0 * r0 - l10 * x[1] - l20 * x[2] - l30 * x[3] - l40 * x[4] - l50 * x[5];
+
+	return true;
+}
+
 } /* namespace iptsd::math */
 
 #endif /* IPTSD_MATH_SLE6_HPP */